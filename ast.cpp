@@ -470,7 +470,7 @@ Decl buildDecl(const nlohmann::json& j) {
 }
 
 // Parses FunctionDef representations from JSON.
-std::unique_ptr<FunctionDef> buildFunctionDef(const nlohmann::json& j) {
+std::unique_ptr<FunctionDef> buildFunctionSignature(const nlohmann::json& j) {
     auto result = std::make_unique<FunctionDef>();
     result->name = j.at("name");
     
@@ -484,13 +484,21 @@ std::unique_ptr<FunctionDef> buildFunctionDef(const nlohmann::json& j) {
         result->locals.push_back(buildDecl(localJson));
     }
     
+    return result;
+}
+
+std::unique_ptr<Stmt> buildFunctionBody(const nlohmann::json& j) {
     // Function body is a Stmts node containing the statement list
     auto stmts_node = std::make_unique<Stmts>();
     for (const auto& stmtJson : j.at("stmts")) {
         stmts_node->statements.push_back(buildStmt(stmtJson));
     }
-    result->body = std::move(stmts_node);
-    
+    return stmts_node;
+}
+
+std::unique_ptr<FunctionDef> buildFunctionDef(const nlohmann::json& j) {
+    auto result = buildFunctionSignature(j);
+    result->body = buildFunctionBody(j);
     return result;
 }
 
@@ -554,3 +562,20 @@ std::unique_ptr<AST::FunCall> buildFunCall(const nlohmann::json& j) {
 std::unique_ptr<AST::Exp> buildExp(const nlohmann::json& j) {
     return AST::buildExp(j);
 }
+
+// Global wrappers used by the streaming lowerer (see streaming.cpp)
+std::unique_ptr<AST::StructDef> buildStructDef(const nlohmann::json& j) {
+    return AST::buildStructDef(j);
+}
+
+AST::Extern buildExtern(const nlohmann::json& j) {
+    return AST::buildExtern(j);
+}
+
+std::unique_ptr<AST::FunctionDef> buildFunctionSignature(const nlohmann::json& j) {
+    return AST::buildFunctionSignature(j);
+}
+
+std::unique_ptr<AST::Stmt> buildFunctionBody(const nlohmann::json& j) {
+    return AST::buildFunctionBody(j);
+}
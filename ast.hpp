@@ -488,6 +488,9 @@ std::unique_ptr<AST::Place> buildPlace(const nlohmann::json& j);
 std::unique_ptr<AST::Stmt> buildStmt(const nlohmann::json& j);
 AST::Decl buildDecl(const nlohmann::json& j);
 std::unique_ptr<AST::FunctionDef> buildFunctionDef(const nlohmann::json& j);
+// A FunctionDef without its body, and the body on its own
+std::unique_ptr<AST::FunctionDef> buildFunctionSignature(const nlohmann::json& j);
+std::unique_ptr<AST::Stmt> buildFunctionBody(const nlohmann::json& j);
 std::unique_ptr<AST::StructDef> buildStructDef(const nlohmann::json& j);
 AST::Extern buildExtern(const nlohmann::json& j);
 std::unique_ptr<AST::Program> buildProgram(const nlohmann::json& j);
@@ -0,0 +1,248 @@
+#include "batch.hpp"
+#include "ast.hpp"
+#include "lir_binary.hpp"
+#include "lir_json.hpp"
+#include "lir_reader.hpp"
+#include "lir_verifier.hpp"
+#include "output_cache.hpp"
+#include "pass_manager.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool is_input(const fs::path& path) {
+    auto ext = path.extension();
+    return ext == ".astj" || ext == ".lir" || ext == ".lirb";
+}
+
+const char* extension_of(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Text: return ".lir";
+        case OutputFormat::Lirb: return ".lirb";
+        case OutputFormat::Json: return ".json";
+    }
+    return "";
+}
+
+// Lowers the program in `j` with one task per function: each builds its
+// function's AST from the JSON and lowers it against the signatures, as
+// --stream does, so a large input keeps every worker busy.
+std::unique_ptr<LIR::Program> lower_functions_in_parallel(const nlohmann::json& j, const LowerOptions& options,
+                                                          ThreadPool& pool) {
+    AST::Program sigs;
+    for (const auto& structJson : j.at("structs")) sigs.structs.push_back(buildStructDef(structJson));
+    for (const auto& externJson : j.at("externs")) sigs.externs.push_back(buildExtern(externJson));
+    const auto& funcs = j.at("functions");
+    for (const auto& funcJson : funcs) sigs.functions.push_back(buildFunctionSignature(funcJson));
+
+    Lowerer module_lowerer(options);
+    auto prog = std::make_unique<LIR::Program>(std::move(module_lowerer.begin_module(&sigs)));
+
+    // Items never wait, so each worker's lowerer serves one item at a time
+    std::vector<std::unique_ptr<Lowerer>> lowerers(pool.size());
+    std::vector<LIR::Function> lowered(sigs.functions.size());
+    pool.parallel_for(lowered.size(), [&](size_t i, size_t worker) {
+        auto& lowerer = lowerers[worker];
+        if (!lowerer) {
+            lowerer = std::make_unique<Lowerer>(options);
+            lowerer->begin_module(&sigs);
+        }
+        AST::FunctionDef* def = sigs.functions[i].get();
+        def->body = buildFunctionBody(funcs[i]);
+        lowered[i] = lowerer->lower_function(def);
+        def->body.reset();
+    });
+    for (auto& fn : lowered) {
+        LIR::FuncId name = fn.name;
+        prog->functions[name] = std::move(fn);
+    }
+    return prog;
+}
+
+// Everything one file in flight needs, reused by the files after it
+struct Slot {
+    explicit Slot(const BatchOptions& options, ThreadPool& pool)
+        : lowerer(std::make_unique<Lowerer>(options.lower)),
+          pm(LIR::build_pipeline(options.opt_level, pool, options.fuse_branch_cmp)) {}
+
+    std::unique_ptr<Lowerer> lowerer;
+    LIR::PassManager pm;
+    LIR::LirEmitter emitter{-1};
+};
+
+int create_output(const fs::path& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("cannot create " + path.string() + ": " + std::strerror(errno));
+    return fd;
+}
+
+} // namespace
+
+std::unique_ptr<LIR::Program> load_input(const std::string& file, Lowerer& lowerer, ThreadPool& pool) {
+    fs::path path = file;
+    if (path.extension() == ".lir") return std::make_unique<LIR::Program>(LIR::read_lir_file(path));
+    if (path.extension() == ".lirb") return std::make_unique<LIR::Program>(LIR::LirbFile(path).read_program());
+
+    std::ifstream input(path);
+    if (!input) throw std::runtime_error("cannot open " + path.string());
+    // The JSON document is only needed to build the AST
+    nlohmann::json j = nlohmann::json::parse(input);
+    if (pool.size() > 1) return lower_functions_in_parallel(j, lowerer.options(), pool);
+    std::unique_ptr<AST::Program> ast = buildProgram(j);
+    j = nullptr;
+    return lowerer.lower(ast.get());
+}
+
+void emit_program(const LIR::Program& prog, OutputFormat format, LIR::LirEmitter& out, ThreadPool* pool) {
+    switch (format) {
+        case OutputFormat::Lirb:
+            out.append(LIR::encode_lirb(prog));
+            break;
+        case OutputFormat::Json:
+            LIR::emit_json(prog, out);
+            break;
+        case OutputFormat::Text:
+            if (pool) out.emit(prog, *pool);
+            else out.emit(prog);
+            break;
+    }
+}
+
+std::vector<std::string> collect_batch_inputs(const std::string& dir_or_list) {
+    std::vector<std::string> inputs;
+    std::error_code ec;
+    if (fs::is_directory(dir_or_list, ec)) {
+        for (const auto& entry : fs::directory_iterator(dir_or_list)) {
+            if (entry.is_regular_file() && is_input(entry.path())) inputs.push_back(entry.path().string());
+        }
+        std::sort(inputs.begin(), inputs.end());
+        return inputs;
+    }
+
+    std::ifstream list(dir_or_list);
+    if (!list) throw std::runtime_error("cannot read input list " + dir_or_list);
+    std::string line;
+    while (std::getline(list, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        inputs.push_back(line.substr(start, end - start + 1));
+    }
+    return inputs;
+}
+
+size_t run_batch(const std::vector<std::string>& inputs, const std::string& out_dir,
+                 const BatchOptions& options) {
+    fs::create_directories(out_dir);
+
+    // Output names are settled up front; a later input that would overwrite
+    // an earlier one's output fails instead
+    std::vector<std::string> errors(inputs.size());
+    std::vector<fs::path> out_paths(inputs.size());
+    std::set<fs::path> taken;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        out_paths[i] = fs::path(out_dir) / fs::path(inputs[i]).stem();
+        out_paths[i] += extension_of(options.format);
+        if (!taken.insert(out_paths[i]).second) {
+            errors[i] = "output " + out_paths[i].string() + " is already written by an earlier input";
+        }
+    }
+
+    // Files are tasks on the pool, and so are their functions (lowering,
+    // passes and rendering), which workers without a file of their own steal
+    ThreadPool pool(options.threads);
+    std::mutex slots_mutex;
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Slot*> free_slots;
+    auto acquire = [&]() -> Slot& {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        if (free_slots.empty()) {
+            slots.push_back(std::make_unique<Slot>(options, pool));
+            return *slots.back();
+        }
+        Slot* slot = free_slots.back();
+        free_slots.pop_back();
+        return *slot;
+    };
+    auto release = [&](Slot& slot) {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        free_slots.push_back(&slot);
+    };
+
+    std::atomic<size_t> cached{0};
+    pool.parallel_for(inputs.size(), [&](size_t i, size_t) {
+        if (!errors[i].empty()) return;
+        Slot& slot = acquire();
+        const fs::path& out_path = out_paths[i];
+        int fd = -1;
+        try {
+            std::string key;
+            bool hit = false;
+            if (options.cache) {
+                key = options.cache->key_of(inputs[i]);
+                fd = create_output(out_path);
+                hit = options.cache->fetch(key, fd);
+            }
+            if (hit) {
+                ++cached;
+            } else {
+                auto prog = load_input(inputs[i], *slot.lowerer, pool);
+                if (options.verify) LIR::verify(*prog);
+                slot.pm.run(*prog);
+                if (options.verify) LIR::verify(*prog);
+
+                if (fd < 0) fd = create_output(out_path);
+                slot.emitter.retarget(fd);
+                emit_program(*prog, options.format, slot.emitter, &pool);
+                slot.emitter.flush();
+            }
+            ::close(fd);
+            fd = -1;
+            if (options.cache && !hit) options.cache->store(key, out_path);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+            slot.emitter.discard();
+            if (fd >= 0) {
+                ::close(fd);
+                ::unlink(out_path.c_str());
+            }
+            // A lowering cut short may leave state behind
+            slot.lowerer = std::make_unique<Lowerer>(options.lower);
+        }
+        release(slot);
+    });
+
+    // Reported in input order, whatever order the files finished in
+    size_t failed = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (errors[i].empty()) continue;
+        std::cerr << "Error: " << inputs[i] << ": " << errors[i] << "\n";
+        ++failed;
+    }
+    // One report for the whole batch, however the inputs were spread over
+    // the slots
+    if (options.time_passes) {
+        std::vector<const LIR::PassManager*> pms;
+        for (const auto& slot : slots) pms.push_back(&slot->pm);
+        LIR::PassManager::print_report(std::cerr, pms);
+    }
+    std::cerr << "Lowered " << inputs.size() - failed << " of " << inputs.size() << " input(s) into "
+              << out_dir;
+    if (options.cache) std::cerr << " (" << cached << " from cache)";
+    std::cerr << "\n";
+    return failed;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "lir_emitter.hpp"
+#include "lowerer.hpp"
+#include "thread_pool.hpp"
+#include <string>
+#include <vector>
+
+// Batch mode (--batch): lower many inputs in one process, writing one output
+// file per input. The lowerer, the pass manager (with its thread pool and
+// scratch arenas) and the output buffer are created once and reused for every
+// input, and a failing input is reported and skipped.
+
+class OutputCache;
+
+enum class OutputFormat { Text, Lirb, Json };
+
+struct BatchOptions {
+    LowerOptions lower;
+    int opt_level = 0;
+    bool fuse_branch_cmp = false;
+    bool verify = false;
+    bool time_passes = false;
+    size_t threads = 1;
+    OutputFormat format = OutputFormat::Text;
+    // Serves inputs seen before and stores the others' outputs, if set
+    OutputCache* cache = nullptr;
+};
+
+// Reads an LIR input (.lir or .lirb), or parses and lowers an AST; an AST's
+// functions are lowered in parallel on `pool`. Throws on errors.
+std::unique_ptr<LIR::Program> load_input(const std::string& path, Lowerer& lowerer, ThreadPool& pool);
+
+// Writes `prog` to `out` in `format`; text is rendered on `pool` if given
+void emit_program(const LIR::Program& prog, OutputFormat format, LIR::LirEmitter& out,
+                  ThreadPool* pool = nullptr);
+
+// The inputs named by `dir_or_list`: the .astj, .lir and .lirb files of a
+// directory in name order, or the lines of a list file (blank lines and
+// '#' comments skipped). Throws std::runtime_error if it cannot be read.
+std::vector<std::string> collect_batch_inputs(const std::string& dir_or_list);
+
+// Lowers each input into `out_dir` (created if missing) as <stem>.lir,
+// .lirb or .json. Errors are printed to stderr per input; returns how many
+// inputs failed.
+size_t run_batch(const std::vector<std::string>& inputs, const std::string& out_dir,
+                 const BatchOptions& options);
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Benchmark script for batch mode scheduling
+# Builds a skewed corpus (one large input among many small ones), lowers it
+# with --batch on 1-64 threads, reports wall time and speedup, and checks the
+# outputs never change. Without function-level tasks the large input would
+# keep one worker busy long after the others ran out of files.
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+if [ ! -f "./lower" ]; then
+    echo -e "${RED}Error: './lower' executable not found. Run 'make' first.${NC}"
+    exit 1
+fi
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <large.astj> <small.astj> [small-copies] [opt-level] [repetitions]"
+    exit 1
+fi
+
+large="$1"
+small="$2"
+copies="${3:-50}"
+opt="${4:--O2}"
+reps="${5:-3}"
+thread_counts="1 2 4 8 16 32 64"
+
+corpus=$(mktemp -d)
+trap 'rm -rf "$corpus"' EXIT
+mkdir "$corpus/in"
+cp "$large" "$corpus/in/large.astj"
+for ((c = 0; c < copies; c++)); do
+    cp "$small" "$corpus/in/small$c.astj"
+done
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}Batch scaling: 1 large + $copies small ($opt, best of $reps)${NC}"
+echo -e "${BLUE}========================================${NC}"
+printf "%8s %12s %9s\n" "Threads" "Wall(ms)" "Speedup"
+
+base_ms=""
+status=0
+for t in $thread_counts; do
+    best=""
+    for ((r = 0; r < reps; r++)); do
+        rm -rf "$corpus/out"
+        start=$(date +%s%N)
+        if ! ./lower "$opt" --threads="$t" --batch "$corpus/in" --out "$corpus/out" 2>/dev/null; then
+            echo -e "${RED}Error: batch failed with $t thread(s)${NC}"
+            exit 1
+        fi
+        ms=$(( ($(date +%s%N) - start) / 1000000 ))
+        # Outputs must not depend on the thread count
+        if [ ! -d "$corpus/reference" ]; then
+            mv "$corpus/out" "$corpus/reference"
+        elif ! diff -rq "$corpus/out" "$corpus/reference" >/dev/null; then
+            echo -e "${RED}MISMATCH${NC} output with $t thread(s) differs from 1 thread"
+            status=1
+        fi
+        if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+            best=$ms
+        fi
+    done
+    [ -z "$base_ms" ] && base_ms=$best
+    speedup=$(awk "BEGIN { printf \"%.2f\", $base_ms / ($best > 0 ? $best : 1) }")
+    printf "%8s %12s %8sx\n" "$t" "$best" "$speedup"
+done
+
+if [ $status -eq 0 ]; then
+    echo -e "${GREEN}Output identical for all thread counts${NC}"
+fi
+exit $status
@@ -0,0 +1,67 @@
+#!/bin/bash
+
+# Benchmark script for the LIR optimizer
+# Runs the -O2 pipeline on one input with 1-32 threads, reports the pass
+# manager's wall time and speedup, and checks the output never changes.
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+if [ ! -f "./lower" ]; then
+    echo -e "${RED}Error: './lower' executable not found. Run 'make' first.${NC}"
+    exit 1
+fi
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <file.astj> [opt-level] [repetitions]"
+    exit 1
+fi
+
+input="$1"
+opt="${2:--O2}"
+reps="${3:-3}"
+thread_counts="1 2 4 8 16 32"
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}Optimizer scaling on $input ($opt, best of $reps)${NC}"
+echo -e "${BLUE}========================================${NC}"
+printf "%8s %12s %9s\n" "Threads" "Wall(ms)" "Speedup"
+
+reference=$(mktemp)
+base_ms=""
+status=0
+for t in $thread_counts; do
+    best=""
+    for ((r = 0; r < reps; r++)); do
+        out=$(mktemp)
+        ms=$(./lower "$opt" --threads="$t" --time-passes "$input" 2>&1 >"$out" | awk '/Wall time/ { print $1 }')
+        if [ -z "$ms" ]; then
+            echo -e "${RED}Error: no timing report for $t thread(s)${NC}"
+            rm -f "$out" "$reference"
+            exit 1
+        fi
+        # Output must not depend on the thread count
+        if [ ! -s "$reference" ]; then
+            cp "$out" "$reference"
+        elif ! cmp -s "$out" "$reference"; then
+            echo -e "${RED}MISMATCH${NC} output with $t thread(s) differs from 1 thread"
+            status=1
+        fi
+        rm -f "$out"
+        if [ -z "$best" ] || awk "BEGIN { exit !($ms < $best) }"; then
+            best=$ms
+        fi
+    done
+    [ -z "$base_ms" ] && base_ms=$best
+    speedup=$(awk "BEGIN { printf \"%.2f\", $base_ms / $best }")
+    printf "%8s %12s %8sx\n" "$t" "$best" "$speedup"
+done
+rm -f "$reference"
+
+if [ $status -eq 0 ]; then
+    echo -e "${GREEN}Output identical for all thread counts${NC}"
+fi
+exit $status
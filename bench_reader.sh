@@ -0,0 +1,82 @@
+#!/bin/bash
+
+# Benchmark script for the LIR readers
+# Converts one input to LIR text and lirb, then times './lower' on each of the
+# three forms (JSON AST, .lir, .lirb) and checks they all print the same LIR.
+# Every run prints its output the same way, so the differences between the
+# rows are the cost of getting the program into memory. Damaged lirb files
+# must then be rejected with an error.
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+if [ ! -f "./lower" ]; then
+    echo -e "${RED}Error: './lower' executable not found. Run 'make' first.${NC}"
+    exit 1
+fi
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <file.astj> [repetitions]"
+    exit 1
+fi
+
+input="$1"
+reps="${2:-5}"
+
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+if ! ./lower "$input" > "$workdir/in.lir" || ! ./lower -o lirb "$input" > "$workdir/in.lirb"; then
+    echo -e "${RED}Error: could not lower $input${NC}"
+    exit 1
+fi
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}Reading $input (best of $reps)${NC}"
+echo -e "${BLUE}========================================${NC}"
+printf "%8s %12s %12s %10s\n" "Input" "Bytes" "Wall(ms)" "MB/s"
+
+status=0
+for form in "$input" "$workdir/in.lir" "$workdir/in.lirb"; do
+    best=""
+    for ((r = 0; r < reps; r++)); do
+        start=$(date +%s%N)
+        ./lower "$form" > "$workdir/out.lir" || status=1
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+    done
+    # The text form is what every input must print back
+    if ! cmp -s "$workdir/out.lir" "$workdir/in.lir"; then
+        echo -e "${RED}MISMATCH${NC} output for $form differs from the lowered program"
+        status=1
+    fi
+    bytes=$(wc -c < "$form")
+    name="${form##*.}"
+    awk -v name="$name" -v bytes="$bytes" -v ns="$best" \
+        'BEGIN { printf "%8s %12d %12.3f %10.1f\n", name, bytes, ns / 1e6, bytes / (ns / 1e3) }'
+done
+
+# Damaged lirb must be reported as corrupt, not crash the reader: a truncated
+# file, and one whose string count is 0xFFFFFFFF
+head -c $(($(wc -c < "$workdir/in.lirb") / 2)) "$workdir/in.lirb" > "$workdir/truncated.lirb"
+cp "$workdir/in.lirb" "$workdir/count.lirb"
+strings_at=$(od -An -t u8 -j 8 -N 8 "$workdir/in.lirb" | tr -d ' ')
+printf '\xff\xff\xff\xff' | dd of="$workdir/count.lirb" bs=1 seek="$strings_at" conv=notrunc 2> /dev/null
+for bad in "$workdir/truncated.lirb" "$workdir/count.lirb"; do
+    ./lower "$bad" > /dev/null 2> "$workdir/err.txt"
+    code=$?
+    if [ $code -ne 1 ] || ! grep -q "lirb: corrupt file" "$workdir/err.txt"; then
+        echo -e "${RED}CORRUPT${NC} $(basename "$bad") exited with $code instead of reporting corruption"
+        status=1
+    fi
+done
+
+if [ $status -eq 0 ]; then
+    echo -e "${GREEN}All inputs round-trip to the same LIR, damaged lirb is rejected${NC}"
+fi
+exit $status
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// --- DenseBitSet ---
+//
+// Fixed-size bit set used by the dataflow solver (dataflow.hpp). The storage
+// is padded to a multiple of 256 bits so the set operations below can work a
+// full vector register at a time with no scalar tail: AVX2 when compiled with
+// -mavx2, SSE2 on any x86-64, plain 64-bit words otherwise. Bits past size()
+// are always zero.
+
+namespace bitset_detail {
+struct Or     { static uint64_t op(uint64_t a, uint64_t b) { return a | b; } };
+struct And    { static uint64_t op(uint64_t a, uint64_t b) { return a & b; } };
+struct AndNot { static uint64_t op(uint64_t a, uint64_t b) { return a & ~b; } };
+} // namespace bitset_detail
+
+class DenseBitSet {
+public:
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t BLOCK_WORDS = 4; // 256 bits
+
+    DenseBitSet() = default;
+    explicit DenseBitSet(size_t nbits)
+        : m_bits(nbits),
+          m_words(((nbits + WORD_BITS * BLOCK_WORDS - 1) / (WORD_BITS * BLOCK_WORDS)) * BLOCK_WORDS, 0) {}
+
+    size_t size() const { return m_bits; }
+
+    bool test(size_t i) const { return (m_words[i / WORD_BITS] >> (i % WORD_BITS)) & 1; }
+    void set(size_t i) { m_words[i / WORD_BITS] |= uint64_t(1) << (i % WORD_BITS); }
+    void reset(size_t i) { m_words[i / WORD_BITS] &= ~(uint64_t(1) << (i % WORD_BITS)); }
+
+    void clear() {
+        for (auto& w : m_words) w = 0;
+    }
+    // Sets every bit in [0, size())
+    void fill() {
+        for (auto& w : m_words) w = ~uint64_t(0);
+        trim();
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (auto w : m_words) n += __builtin_popcountll(w);
+        return n;
+    }
+
+    bool operator==(const DenseBitSet& other) const { return m_words == other.m_words; }
+    bool operator!=(const DenseBitSet& other) const { return !(*this == other); }
+
+    // In-place set operations. Each returns true if *this changed.
+    // `other` must have the same size.
+    bool union_with(const DenseBitSet& other) { return apply<bitset_detail::Or>(other); }
+    bool intersect_with(const DenseBitSet& other) { return apply<bitset_detail::And>(other); }
+    bool subtract(const DenseBitSet& other) { return apply<bitset_detail::AndNot>(other); }
+
+    // *this = gen | (in & ~kill), the usual transfer function; returns true if *this changed
+    bool assign_transfer(const DenseBitSet& gen, const DenseBitSet& in, const DenseBitSet& kill);
+
+    // Calls f(i) for every set bit, in increasing order
+    template <typename F>
+    void for_each(F&& f) const {
+        for (size_t w = 0; w < m_words.size(); ++w) {
+            uint64_t bits = m_words[w];
+            while (bits) {
+                f(w * WORD_BITS + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    template <typename Op>
+    bool apply(const DenseBitSet& other);
+
+    void trim() {
+        size_t used = m_bits % WORD_BITS;
+        size_t last = m_bits / WORD_BITS;
+        if (last < m_words.size() && used) m_words[last] &= (uint64_t(1) << used) - 1;
+        for (size_t w = last + (used ? 1 : 0); w < m_words.size(); ++w) m_words[w] = 0;
+    }
+
+    size_t m_bits = 0;
+    std::vector<uint64_t> m_words;
+};
+
+// --- Vectorized Kernels ---
+
+#if defined(__AVX2__)
+
+template <typename Op>
+inline __m256i dense_bitset_op(__m256i a, __m256i b) {
+    if constexpr (std::is_same_v<Op, bitset_detail::Or>) return _mm256_or_si256(a, b);
+    else if constexpr (std::is_same_v<Op, bitset_detail::And>) return _mm256_and_si256(a, b);
+    else return _mm256_andnot_si256(b, a);
+}
+
+template <typename Op>
+inline bool DenseBitSet::apply(const DenseBitSet& other) {
+    __m256i diff = _mm256_setzero_si256();
+    for (size_t w = 0; w < m_words.size(); w += BLOCK_WORDS) {
+        auto* dst = reinterpret_cast<__m256i*>(&m_words[w]);
+        __m256i a = _mm256_loadu_si256(dst);
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&other.m_words[w]));
+        __m256i r = dense_bitset_op<Op>(a, b);
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(a, r));
+        _mm256_storeu_si256(dst, r);
+    }
+    return !_mm256_testz_si256(diff, diff);
+}
+
+inline bool DenseBitSet::assign_transfer(const DenseBitSet& gen, const DenseBitSet& in, const DenseBitSet& kill) {
+    __m256i diff = _mm256_setzero_si256();
+    for (size_t w = 0; w < m_words.size(); w += BLOCK_WORDS) {
+        auto* dst = reinterpret_cast<__m256i*>(&m_words[w]);
+        __m256i old = _mm256_loadu_si256(dst);
+        __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&gen.m_words[w]));
+        __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in.m_words[w]));
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&kill.m_words[w]));
+        __m256i r = _mm256_or_si256(g, _mm256_andnot_si256(k, i));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(old, r));
+        _mm256_storeu_si256(dst, r);
+    }
+    return !_mm256_testz_si256(diff, diff);
+}
+
+#elif defined(__SSE2__)
+
+template <typename Op>
+inline __m128i dense_bitset_op(__m128i a, __m128i b) {
+    if constexpr (std::is_same_v<Op, bitset_detail::Or>) return _mm_or_si128(a, b);
+    else if constexpr (std::is_same_v<Op, bitset_detail::And>) return _mm_and_si128(a, b);
+    else return _mm_andnot_si128(b, a);
+}
+
+// True if any bit of `v` is set (SSE2 has no ptest)
+inline bool dense_bitset_any(__m128i v) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xFFFF;
+}
+
+template <typename Op>
+inline bool DenseBitSet::apply(const DenseBitSet& other) {
+    __m128i diff = _mm_setzero_si128();
+    for (size_t w = 0; w < m_words.size(); w += 2) {
+        auto* dst = reinterpret_cast<__m128i*>(&m_words[w]);
+        __m128i a = _mm_loadu_si128(dst);
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.m_words[w]));
+        __m128i r = dense_bitset_op<Op>(a, b);
+        diff = _mm_or_si128(diff, _mm_xor_si128(a, r));
+        _mm_storeu_si128(dst, r);
+    }
+    return dense_bitset_any(diff);
+}
+
+inline bool DenseBitSet::assign_transfer(const DenseBitSet& gen, const DenseBitSet& in, const DenseBitSet& kill) {
+    __m128i diff = _mm_setzero_si128();
+    for (size_t w = 0; w < m_words.size(); w += 2) {
+        auto* dst = reinterpret_cast<__m128i*>(&m_words[w]);
+        __m128i old = _mm_loadu_si128(dst);
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&gen.m_words[w]));
+        __m128i i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in.m_words[w]));
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kill.m_words[w]));
+        __m128i r = _mm_or_si128(g, _mm_andnot_si128(k, i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(old, r));
+        _mm_storeu_si128(dst, r);
+    }
+    return dense_bitset_any(diff);
+}
+
+#else
+
+template <typename Op>
+inline bool DenseBitSet::apply(const DenseBitSet& other) {
+    uint64_t diff = 0;
+    for (size_t w = 0; w < m_words.size(); ++w) {
+        uint64_t r = Op::op(m_words[w], other.m_words[w]);
+        diff |= m_words[w] ^ r;
+        m_words[w] = r;
+    }
+    return diff != 0;
+}
+
+inline bool DenseBitSet::assign_transfer(const DenseBitSet& gen, const DenseBitSet& in, const DenseBitSet& kill) {
+    uint64_t diff = 0;
+    for (size_t w = 0; w < m_words.size(); ++w) {
+        uint64_t r = gen.m_words[w] | (in.m_words[w] & ~kill.m_words[w]);
+        diff |= m_words[w] ^ r;
+        m_words[w] = r;
+    }
+    return diff != 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+// Host-side check of the liblower.a API (`make check`): links the library as
+// an embedding program would and feeds it good and damaged input. A damaged
+// lirb buffer must come back as the result's error, never take the host down.
+
+#include "liblower.hpp"
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const char* PROGRAM = R"(extern print: (int) -> int
+
+fn main() -> int {
+let _const_1:int, x:int
+
+entry:
+  _const_1 = $const 1
+  x = $call print(_const_1)
+  $ret x
+}
+)";
+
+int failures = 0;
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL " << what << "\n";
+        ++failures;
+    }
+}
+
+uint64_t read_u64(const std::string& bytes, size_t at) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[at + i])) << (8 * i);
+    return v;
+}
+
+} // namespace
+
+int main() {
+    LibraryOptions to_lirb;
+    to_lirb.output = OutputFormat::Lirb;
+    LowerResult encoded = lower_to_buffer(PROGRAM, to_lirb);
+    expect(encoded.ok(), "encode lirb: " + encoded.error);
+    const std::string& lirb = encoded.output;
+
+    LowerResult decoded = lower_to_buffer(lirb);
+    // Functions are printed with a blank line after each
+    expect(decoded.ok() && decoded.output == std::string(PROGRAM) + "\n", "lirb round trip: " + decoded.error);
+
+    // JSON that is not an AST program fails to parse, not to lower
+    LowerResult shapeless = lower_to_buffer(R"({"externs": [], "functions": []})");
+    expect(!shapeless.ok() && shapeless.error.rfind("parse: ", 0) == 0, "AST without structs: " + shapeless.error);
+
+    LowerResult truncated = lower_to_buffer(lirb.substr(0, lirb.size() / 2));
+    expect(!truncated.ok(), "truncated lirb is accepted");
+
+    // The string table starts with its count; the header's second field
+    // points at it
+    std::string count = lirb;
+    count.replace(read_u64(lirb, 8), 4, "\xff\xff\xff\xff");
+    LowerResult counted = lower_to_buffer(count);
+    expect(!counted.ok() && counted.error.rfind("parse: lirb: corrupt", 0) == 0,
+           "string count 0xFFFFFFFF: " + counted.error);
+
+    // Any single damaged byte either still decodes or is reported; getting
+    // here at all is the check
+    for (size_t i = 4; i < lirb.size(); ++i) {
+        std::string damaged = lirb;
+        damaged[i] = '\xff';
+        lower_to_buffer(damaged, {});
+    }
+
+    if (failures) return 1;
+    std::cout << "liblower checks passed\n";
+    return 0;
+}
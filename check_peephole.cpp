@@ -0,0 +1,81 @@
+// Rule-level check of the peephole pass (`make check`): runs the pass alone
+// on small functions and looks at what the rules made of them. Add, sub and
+// mul wrap (see InstInfo::can_trap), so reassociation may fold constants
+// across a possible overflow.
+
+#include "lir_passes.hpp"
+#include "lir_reader.hpp"
+#include "lir_utils.hpp"
+#include "pass_manager.hpp"
+#include <iostream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL " << what << "\n";
+        ++failures;
+    }
+}
+
+// Runs the peephole pass on `text` and returns the program
+LIR::Program peephole(const char* text) {
+    LIR::Program prog = LIR::parse_lir(text);
+    LIR::PassManager pm;
+    pm.add(LIR::create_peephole_pass());
+    pm.run(prog);
+    return prog;
+}
+
+// Operands read by the instruction of `fn` that defines `var`
+std::string uses_of(const LIR::Program& prog, const LIR::VarId& var) {
+    std::string uses;
+    for (const auto& [label, bb] : prog.functions.at("f").body) {
+        for (const auto& inst : bb.insts) {
+            const LIR::VarId* def = LIR::inst_def(inst);
+            if (!def || *def != var) continue;
+            uses.clear();
+            LIR::for_each_use(inst, [&](const LIR::VarId& v) { uses += (uses.empty() ? "" : " ") + v; });
+        }
+    }
+    return uses;
+}
+
+} // namespace
+
+int main() {
+    // (x + 1) - 1 reads x directly, even though x + 1 wraps for x = INT_MAX
+    LIR::Program add = peephole(R"(fn f(x:int) -> int {
+let _const_1:int, y:int, z:int
+
+entry:
+  _const_1 = $const 1
+  y = $arith add x _const_1
+  z = $arith sub y _const_1
+  $ret z
+}
+)");
+    std::string add_uses = uses_of(add, "z");
+    expect(add_uses == "x" || add_uses == "x _const_0", "(x + 1) - 1 not reassociated: z reads " + add_uses);
+
+    // (x * -1) * -1 likewise, though x * -1 wraps for x = INT_MIN
+    LIR::Program mul = peephole(R"(fn f(x:int) -> int {
+let _const_n1:int, y:int, z:int
+
+entry:
+  _const_n1 = $const -1
+  y = $arith mul x _const_n1
+  z = $arith mul y _const_n1
+  $ret z
+}
+)");
+    std::string mul_uses = uses_of(mul, "z");
+    expect(mul_uses == "x" || mul_uses == "x _const_1", "(x * -1) * -1 not reassociated: z reads " + mul_uses);
+
+    if (failures) return 1;
+    std::cout << "peephole checks passed\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "dataflow.hpp"
+
+namespace LIR {
+
+// --- VarIndex ---
+
+VarIndex::VarIndex(const Function& fn) {
+    m_ids.reserve(fn.locals.size());
+    m_names.reserve(fn.locals.size());
+    for (const auto& [name, typ] : fn.locals) {
+        m_ids.emplace(name, static_cast<uint32_t>(m_names.size()));
+        m_names.push_back(&name);
+    }
+}
+
+namespace {
+
+struct LivenessProblem {
+    static constexpr Direction direction = Direction::Backward;
+    static constexpr Meet meet = Meet::Union;
+
+    const Liveness& live;
+
+    size_t universe() const { return live.vars.size(); }
+
+    void local(const BasicBlock& bb, DenseBitSet& gen, DenseBitSet& kill) const {
+        // gen = upward-exposed uses, kill = defs
+        live.step_backward(bb.term, gen);
+        for (auto it = bb.insts.rbegin(); it != bb.insts.rend(); ++it) {
+            if (const VarId* def = inst_def(*it)) {
+                uint32_t id = live.vars.id(*def);
+                if (id != VarIndex::NONE) kill.set(id);
+            }
+            live.step_backward(*it, gen);
+        }
+    }
+
+    void boundary(DenseBitSet&) const {} // nothing is live after a return
+};
+
+struct ReachingDefsProblem {
+    static constexpr Direction direction = Direction::Forward;
+    static constexpr Meet meet = Meet::Union;
+
+    const ReachingDefs& rd;
+    const std::map<BbId, size_t>& first_def; // index of each block's first def in rd.defs
+    const std::vector<std::vector<uint32_t>>& defs_of_var;
+
+    size_t universe() const { return rd.defs.size(); }
+
+    void local(const BasicBlock& bb, DenseBitSet& gen, DenseBitSet& kill) const {
+        auto it = first_def.find(bb.label);
+        if (it == first_def.end()) return;
+        for (size_t d = it->second; d < rd.defs.size() && rd.defs[d].block == bb.label; ++d) {
+            // A later def of the same variable in the block supersedes this one
+            for (uint32_t other : defs_of_var[rd.defs[d].var]) {
+                kill.set(other);
+                gen.reset(other);
+            }
+            gen.set(d);
+        }
+    }
+
+    void boundary(DenseBitSet&) const {}
+};
+
+} // namespace
+
+Liveness Liveness::compute(const Function& fn) {
+    Liveness live;
+    live.vars = VarIndex(fn);
+    live.sets = solve_dataflow(fn, CFGInfo::compute(fn), LivenessProblem{live});
+    return live;
+}
+
+ReachingDefs ReachingDefs::compute(const Function& fn) {
+    ReachingDefs rd;
+    rd.vars = VarIndex(fn);
+    std::map<BbId, size_t> first_def;
+    std::vector<std::vector<uint32_t>> defs_of_var(rd.vars.size());
+    for (const auto& [label, bb] : fn.body) {
+        for (size_t i = 0; i < bb.insts.size(); ++i) {
+            const VarId* def = inst_def(bb.insts[i]);
+            if (!def) continue;
+            uint32_t var = rd.vars.id(*def);
+            if (var == VarIndex::NONE) continue;
+            first_def.emplace(label, rd.defs.size());
+            defs_of_var[var].push_back(static_cast<uint32_t>(rd.defs.size()));
+            rd.defs.push_back({label, i, var});
+        }
+    }
+    rd.sets = solve_dataflow(fn, CFGInfo::compute(fn), ReachingDefsProblem{rd, first_def, defs_of_var});
+    return rd;
+}
+
+} // namespace LIR
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "bitset.hpp"
+#include "lir.hpp"
+#include "lir_analysis.hpp"
+#include "lir_utils.hpp"
+#include <climits>
+#include <map>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Iterative bit-vector dataflow over LIR::Function.
+//
+// A problem describes its gen/kill sets per block and the solver finds the
+// fixed point of
+//   forward:  in(B)  = meet over preds P of out(P);  out(B) = gen(B) | (in(B) & ~kill(B))
+//   backward: out(B) = meet over succs S of in(S);   in(B)  = gen(B) | (out(B) & ~kill(B))
+// visiting blocks in reverse postorder (forward) or postorder (backward).
+// Only blocks reachable from `entry` take part.
+
+namespace LIR {
+
+// --- Variable Numbering ---
+
+// Dense ids for a function's locals (parameters included). Names point into
+// fn.locals, so the index is only valid while the set of locals is unchanged.
+class VarIndex {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    VarIndex() = default;
+    explicit VarIndex(const Function& fn);
+
+    size_t size() const { return m_names.size(); }
+    // Id of `v`, or NONE if it is not a local (a function name, __NULL, ...)
+    uint32_t id(std::string_view v) const {
+        auto it = m_ids.find(v);
+        return it == m_ids.end() ? NONE : it->second;
+    }
+    const VarId& name(uint32_t id) const { return *m_names[id]; }
+
+private:
+    std::unordered_map<std::string_view, uint32_t> m_ids;
+    std::vector<const VarId*> m_names;
+};
+
+// --- Solver ---
+
+enum class Direction { Forward, Backward };
+enum class Meet { Union, Intersect };
+
+// A problem type provides:
+//   static constexpr Direction direction;
+//   static constexpr Meet meet;
+//   size_t universe() const;                      -- number of bits
+//   void local(const BasicBlock& bb, DenseBitSet& gen, DenseBitSet& kill) const;
+//   void boundary(DenseBitSet& set) const;        -- value entering `entry` (forward)
+//                                                    or leaving exit blocks (backward)
+
+struct DataflowResult {
+    std::vector<BbId> blocks; // reverse postorder
+    std::map<BbId, size_t> index;
+    std::vector<DenseBitSet> in, out;
+
+    bool reached(const BbId& label) const { return index.count(label) != 0; }
+    const DenseBitSet& in_of(const BbId& label) const { return in[index.at(label)]; }
+    const DenseBitSet& out_of(const BbId& label) const { return out[index.at(label)]; }
+};
+
+template <typename Problem>
+DataflowResult solve_dataflow(const Function& fn, const CFGInfo& cfg, const Problem& problem) {
+    constexpr bool forward = Problem::direction == Direction::Forward;
+    const size_t n = cfg.rpo.size();
+    const size_t bits = problem.universe();
+
+    DataflowResult res;
+    res.blocks = cfg.rpo;
+    for (size_t i = 0; i < n; ++i) res.index[cfg.rpo[i]] = i;
+
+    // Edges in the direction of propagation, by block index
+    std::vector<std::vector<size_t>> sources(n), sinks(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (const auto& succ : cfg.succs.at(cfg.rpo[i])) {
+            size_t s = res.index.at(succ);
+            if (forward) { sources[s].push_back(i); sinks[i].push_back(s); }
+            else         { sources[i].push_back(s); sinks[s].push_back(i); }
+        }
+    }
+
+    std::vector<DenseBitSet> gen(n, DenseBitSet(bits)), kill(n, DenseBitSet(bits));
+    for (size_t i = 0; i < n; ++i) {
+        problem.local(fn.body.at(cfg.rpo[i]), gen[i], kill[i]);
+    }
+
+    // meet_side is what flows into a block, result_side what flows out
+    auto& meet_side = forward ? res.in : res.out;
+    auto& result_side = forward ? res.out : res.in;
+    DenseBitSet top(bits);
+    if (Problem::meet == Meet::Intersect) top.fill();
+    DenseBitSet boundary(bits);
+    problem.boundary(boundary);
+    meet_side.assign(n, top);
+    result_side.assign(n, top);
+
+    // Worklist ordered by visiting position: RPO forward, postorder backward
+    auto rank = [&](size_t i) { return forward ? i : n - 1 - i; };
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> worklist;
+    std::vector<bool> queued(n, true);
+    for (size_t i = 0; i < n; ++i) worklist.push(rank(i));
+
+    DenseBitSet incoming(bits);
+    while (!worklist.empty()) {
+        size_t b = rank(worklist.top()); // rank is its own inverse
+        worklist.pop();
+        queued[b] = false;
+
+        // The boundary flows into `entry` (which may also be a loop header)
+        // or out of the blocks that leave the function
+        bool at_boundary = forward ? b == 0 : sources[b].empty();
+        incoming = at_boundary ? boundary : top;
+        for (size_t s : sources[b]) {
+            if (Problem::meet == Meet::Union) incoming.union_with(result_side[s]);
+            else incoming.intersect_with(result_side[s]);
+        }
+        meet_side[b] = incoming;
+        if (!result_side[b].assign_transfer(gen[b], incoming, kill[b])) continue;
+        for (size_t s : sinks[b]) {
+            if (!queued[s]) {
+                queued[s] = true;
+                worklist.push(rank(s));
+            }
+        }
+    }
+    return res;
+}
+
+// --- Analyses ---
+
+// Variables live on entry to / exit from each reachable block.
+struct Liveness {
+    static constexpr bool cfg_only = false;
+
+    VarIndex vars;
+    DataflowResult sets; // in = live-in, out = live-out
+
+    // Turns the set live after `inst` into the set live before it
+    void step_backward(const Inst& inst, DenseBitSet& live) const {
+        if (const VarId* def = inst_def(inst)) {
+            uint32_t id = vars.id(*def);
+            if (id != VarIndex::NONE) live.reset(id);
+        }
+        for_each_use(inst, [&](const VarId& v) {
+            uint32_t id = vars.id(v);
+            if (id != VarIndex::NONE) live.set(id);
+        });
+    }
+    void step_backward(const Terminal& term, DenseBitSet& live) const {
+        for_each_term_use(term, [&](const VarId& v) {
+            uint32_t id = vars.id(v);
+            if (id != VarIndex::NONE) live.set(id);
+        });
+    }
+
+    static Liveness compute(const Function& fn);
+};
+
+// Definitions (instructions writing a local) that may reach each block.
+// Bit i stands for defs[i]; parameters are not definitions.
+struct ReachingDefs {
+    static constexpr bool cfg_only = false;
+
+    struct Def {
+        BbId block;
+        size_t index; // into block.insts
+        uint32_t var; // VarIndex id
+    };
+
+    VarIndex vars;
+    std::vector<Def> defs;
+    DataflowResult sets;
+
+    static ReachingDefs compute(const Function& fn);
+};
+
+} // namespace LIR
@@ -0,0 +1,130 @@
+#include "def_use.hpp"
+#include "lir_utils.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace LIR {
+
+namespace {
+
+const std::vector<DefUseIndex::NodeId> NO_NODES;
+
+// Removes one occurrence of `n` from `list` (order is not kept)
+void remove_one(std::vector<DefUseIndex::NodeId>& list, DefUseIndex::NodeId n) {
+    auto it = std::find(list.begin(), list.end(), n);
+    if (it == list.end()) return;
+    *it = list.back();
+    list.pop_back();
+}
+
+} // namespace
+
+DefUseIndex::DefUseIndex(Function& fn) {
+    for (auto& [label, bb] : fn.body) {
+        auto& nodes = m_inst_nodes[&bb];
+        nodes.reserve(bb.insts.size());
+        for (size_t i = 0; i < bb.insts.size(); ++i) {
+            nodes.push_back(add_node(&bb, static_cast<uint32_t>(i)));
+        }
+        m_term_node[&bb] = add_node(&bb, TERM);
+    }
+}
+
+DefUseIndex::NodeId DefUseIndex::add_node(BasicBlock* bb, uint32_t pos) {
+    NodeId n = static_cast<NodeId>(m_nodes.size());
+    m_nodes.push_back({bb, pos});
+    link(n);
+    return n;
+}
+
+void DefUseIndex::link(NodeId n) {
+    auto add_use = [&](const VarId& v) { m_vars[v].uses.push_back(n); };
+    if (is_term(n)) {
+        for_each_term_use(std::as_const(term(n)), add_use);
+        return;
+    }
+    const Inst& i = inst(n);
+    if (const VarId* def = inst_def(i)) m_vars[*def].defs.push_back(n);
+    for_each_use(i, add_use);
+}
+
+void DefUseIndex::unlink(NodeId n) {
+    auto drop_use = [&](const VarId& v) { remove_one(m_vars[v].uses, n); };
+    if (is_term(n)) {
+        for_each_term_use(std::as_const(term(n)), drop_use);
+        return;
+    }
+    const Inst& i = inst(n);
+    if (const VarId* def = inst_def(i)) remove_one(m_vars[*def].defs, n);
+    for_each_use(i, drop_use);
+}
+
+const std::vector<DefUseIndex::NodeId>& DefUseIndex::defs(const VarId& v) const {
+    auto it = m_vars.find(v);
+    return it == m_vars.end() ? NO_NODES : it->second.defs;
+}
+
+const std::vector<DefUseIndex::NodeId>& DefUseIndex::uses(const VarId& v) const {
+    auto it = m_vars.find(v);
+    return it == m_vars.end() ? NO_NODES : it->second.uses;
+}
+
+void DefUseIndex::replace_all_uses(const VarId& from, const VarId& to) {
+    if (from == to) return;
+    auto it = m_vars.find(from);
+    if (it == m_vars.end()) return;
+    std::vector<NodeId> moved = std::move(it->second.uses);
+    it->second.uses.clear();
+
+    // A node reading `from` twice appears twice; the first visit rewrites both
+    auto rewrite = [&](VarId& v) { if (v == from) v = to; };
+    for (NodeId n : moved) {
+        if (is_term(n)) for_each_term_use(term(n), rewrite);
+        else for_each_use(inst(n), rewrite);
+    }
+    auto& target = m_vars[to].uses; // may rehash; `it` is not used again
+    target.insert(target.end(), moved.begin(), moved.end());
+}
+
+void DefUseIndex::replace(NodeId n, Inst new_inst) {
+    unlink(n);
+    inst(n) = std::move(new_inst);
+    link(n);
+}
+
+void DefUseIndex::set_terminal(BasicBlock& bb, Terminal new_term) {
+    NodeId n = m_term_node.at(&bb);
+    unlink(n);
+    bb.term = std::move(new_term);
+    link(n);
+}
+
+void DefUseIndex::erase(NodeId n) {
+    if (m_nodes[n].erased || is_term(n)) return;
+    unlink(n);
+    m_nodes[n].erased = true;
+    m_dirty.push_back(m_nodes[n].block);
+}
+
+void DefUseIndex::compact() {
+    std::sort(m_dirty.begin(), m_dirty.end());
+    m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+    for (BasicBlock* bb : m_dirty) {
+        auto& nodes = m_inst_nodes[bb];
+        size_t kept = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Node& node = m_nodes[nodes[i]];
+            if (node.erased) continue;
+            if (kept != i) {
+                bb->insts[kept] = std::move(bb->insts[i]);
+                nodes[kept] = nodes[i];
+            }
+            node.pos = static_cast<uint32_t>(kept++);
+        }
+        bb->insts.resize(kept);
+        nodes.resize(kept);
+    }
+    m_dirty.clear();
+}
+
+} // namespace LIR
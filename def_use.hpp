@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lir.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace LIR {
+
+// --- Def-Use Index ---
+
+// Maps every variable of a function to the instructions that define it and
+// the instructions or terminals that read it. Built in one scan over the body
+// and kept up to date by the editing methods below, so a pass can rewrite all
+// uses of a variable without rescanning the function.
+//
+// Instructions and terminals are identified by NodeId, which stays valid
+// across edits: erase() only marks an instruction and compact() removes the
+// marked ones from their blocks. The index holds pointers to the blocks, so
+// blocks must not be added or removed while it is in use.
+class DefUseIndex {
+public:
+    using NodeId = uint32_t;
+
+    explicit DefUseIndex(Function& fn);
+
+    // Defining instructions of `v` (parameters have none)
+    const std::vector<NodeId>& defs(const VarId& v) const;
+    // Readers of `v`, one entry per operand occurrence
+    const std::vector<NodeId>& uses(const VarId& v) const;
+
+    bool is_term(NodeId n) const { return m_nodes[n].pos == TERM; }
+    BasicBlock& block(NodeId n) const { return *m_nodes[n].block; }
+    Inst& inst(NodeId n) const { return m_nodes[n].block->insts[m_nodes[n].pos]; }
+    Terminal& term(NodeId n) const { return m_nodes[n].block->term; }
+
+    // Rewrites every read of `from` into a read of `to`
+    void replace_all_uses(const VarId& from, const VarId& to);
+    // Replaces the instruction at `n`
+    void replace(NodeId n, Inst inst);
+    // Replaces the terminal of `bb`
+    void set_terminal(BasicBlock& bb, Terminal term);
+    // Drops the instruction at `n` from the index; it stays in its block
+    // until compact()
+    void erase(NodeId n);
+    // Removes erased instructions from their blocks
+    void compact();
+
+private:
+    static constexpr uint32_t TERM = UINT32_MAX;
+
+    struct Node {
+        BasicBlock* block;
+        uint32_t pos; // index into block->insts, or TERM
+        bool erased = false;
+    };
+    struct Chains {
+        std::vector<NodeId> defs, uses;
+    };
+
+    NodeId add_node(BasicBlock* bb, uint32_t pos);
+    void link(NodeId n);
+    void unlink(NodeId n);
+
+    std::unordered_map<VarId, Chains> m_vars;
+    std::vector<Node> m_nodes;
+    std::unordered_map<BasicBlock*, std::vector<NodeId>> m_inst_nodes; // in block order
+    std::unordered_map<BasicBlock*, NodeId> m_term_node;
+    std::vector<BasicBlock*> m_dirty; // blocks with erased instructions
+};
+
+} // namespace LIR
@@ -0,0 +1,269 @@
+#include "lir_passes.hpp"
+#include "dataflow.hpp"
+#include "lir_utils.hpp"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+// Global value numbering over the dominator tree.
+//
+// Blocks are visited in dominator-tree preorder. Each block starts with the
+// expressions available at the end of its immediate dominator, minus those
+// whose operands (or holder) may be reassigned on the way: in the dominator
+// itself after the expression, or in any block on a path from the dominator
+// to this block. An instruction recomputing an available expression becomes
+// a copy of the variable holding it; copy-prop and DCE clean up afterwards.
+//
+// Loads are numbered too, with a type-based alias model: a store through a
+// pointer to T may change any load of a T, a call may change any load.
+
+namespace LIR {
+
+namespace {
+
+struct Available {
+    VarId holder;
+    std::vector<uint32_t> vars; // operands and holder that must not change
+    int mem = -1;               // loads: pointee type read, else -1
+};
+using Table = std::unordered_map<std::string, Available>;
+
+// What executing some blocks may change
+struct Clobbers {
+    explicit Clobbers(size_t nvars) : vars(nvars) {}
+
+    DenseBitSet vars;
+    bool all_memory = false;
+    std::set<int> memory; // pointee types stored to
+
+    void merge(const Clobbers& other) {
+        vars.union_with(other.vars);
+        all_memory |= other.all_memory;
+        memory.insert(other.memory.begin(), other.memory.end());
+    }
+};
+
+class GlobalValueNumbering {
+public:
+    GlobalValueNumbering(Function& fn, const CFGInfo& cfg, const DomTree& dom)
+        : m_fn(fn), m_cfg(cfg), m_dom(dom), m_vars(fn) {}
+
+    bool run() {
+        const auto& rpo = m_dom.rpo;
+        if (rpo.empty()) return false;
+        for (const auto& label : rpo) m_clobbers.emplace(label, block_clobbers(m_fn.body.at(label)));
+
+        std::map<BbId, Table> end_tables;
+        std::map<BbId, size_t> pending; // children not yet visited
+        std::vector<BbId> stack{"entry"};
+        bool changed = false;
+        while (!stack.empty()) {
+            BbId label = stack.back();
+            stack.pop_back();
+
+            Table table;
+            if (label != "entry") {
+                const BbId& parent = m_dom.idom.at(label);
+                table = filtered(end_tables.at(parent), region_clobbers(parent, label));
+                if (--pending[parent] == 0) end_tables.erase(parent);
+            }
+            changed |= number_block(m_fn.body.at(label), table);
+
+            const auto& kids = m_dom.children.at(label);
+            if (kids.empty()) continue;
+            end_tables[label] = std::move(table);
+            pending[label] = kids.size();
+            for (auto it = kids.rbegin(); it != kids.rend(); ++it) stack.push_back(*it);
+        }
+        return changed;
+    }
+
+private:
+    // Pointee type of a pointer variable as a small id; -1 if unknown
+    int pointee_type(const VarId& ptr) {
+        auto it = m_fn.locals.find(ptr);
+        if (it == m_fn.locals.end()) return -1;
+        auto* p = dynamic_cast<const PtrType*>(it->second.get());
+        if (!p) return -1;
+        std::ostringstream os;
+        os << p->element;
+        return m_type_ids.emplace(os.str(), static_cast<int>(m_type_ids.size())).first->second;
+    }
+
+    Clobbers block_clobbers(const BasicBlock& bb) {
+        Clobbers c(m_vars.size());
+        for (const auto& inst : bb.insts) {
+            if (const VarId* def = inst_def(inst)) {
+                uint32_t id = m_vars.id(*def);
+                if (id != VarIndex::NONE) c.vars.set(id);
+            }
+            if (auto* store = std::get_if<Store>(&inst)) {
+                int t = pointee_type(store->dst);
+                if (t < 0) c.all_memory = true; else c.memory.insert(t);
+            } else if (std::holds_alternative<Call>(inst)) {
+                c.all_memory = true;
+            }
+        }
+        return c;
+    }
+
+    // Everything that may run between the end of `dom` and the start of
+    // `block`: the blocks that reach `block` without passing through `dom`.
+    Clobbers region_clobbers(const BbId& dom, const BbId& block) {
+        Clobbers c(m_vars.size());
+        const auto& preds = m_cfg.preds.at(block);
+        if (preds.size() == 1 && preds[0] == dom) return c;
+
+        std::set<BbId> seen;
+        std::vector<BbId> work;
+        for (const auto& p : preds) {
+            if (p != dom && m_clobbers.count(p) && seen.insert(p).second) work.push_back(p);
+        }
+        while (!work.empty()) {
+            BbId cur = work.back();
+            work.pop_back();
+            c.merge(m_clobbers.at(cur));
+            for (const auto& p : m_cfg.preds.at(cur)) {
+                if (p != dom && m_clobbers.count(p) && seen.insert(p).second) work.push_back(p);
+            }
+        }
+        return c;
+    }
+
+    static Table filtered(const Table& table, const Clobbers& c) {
+        Table out;
+        for (const auto& [key, avail] : table) {
+            if (avail.mem >= 0 && (c.all_memory || c.memory.count(avail.mem))) continue;
+            bool killed = false;
+            for (uint32_t v : avail.vars) killed |= c.vars.test(v);
+            if (!killed) out.emplace(key, avail);
+        }
+        return out;
+    }
+
+    // Value key of a pure (or load) instruction; empty if it is not numbered
+    std::string key_of(const Inst& inst) {
+        std::string key;
+        if (auto* arith = std::get_if<Arith>(&inst)) {
+            const VarId *l = &arith->left, *r = &arith->right;
+            bool commutes = arith->aop == ArithOp::Add || arith->aop == ArithOp::Mul;
+            if (commutes && *r < *l) std::swap(l, r);
+            key = "arith " + std::to_string(static_cast<int>(arith->aop)) + " " + *l + " " + *r;
+        } else if (auto* cmp = std::get_if<Cmp>(&inst)) {
+            // a < b is b > a: order the operands and mirror the relation
+            RelOp rop = cmp->rop;
+            const VarId *l = &cmp->left, *r = &cmp->right;
+            if (*r < *l) {
+                std::swap(l, r);
+                switch (rop) {
+                    case RelOp::Lt:  rop = RelOp::Gt; break;
+                    case RelOp::Gt:  rop = RelOp::Lt; break;
+                    case RelOp::Lte: rop = RelOp::Gte; break;
+                    case RelOp::Gte: rop = RelOp::Lte; break;
+                    default: break;
+                }
+            }
+            key = "cmp " + std::to_string(static_cast<int>(rop)) + " " + *l + " " + *r;
+        } else if (auto* gfp = std::get_if<Gfp>(&inst)) {
+            key = "gfp " + gfp->src + " " + gfp->sid + " " + gfp->field;
+        } else if (auto* gep = std::get_if<Gep>(&inst)) {
+            key = "gep " + gep->src + " " + gep->idx + (gep->checked ? " 1" : " 0");
+        } else if (auto* sel = std::get_if<Select>(&inst)) {
+            key = "select " + sel->guard + " " + sel->tt + " " + sel->ff;
+        } else if (auto* load = std::get_if<Load>(&inst)) {
+            if (pointee_type(load->src) >= 0) key = "load " + load->src;
+        }
+        return key;
+    }
+
+    static void kill_var(Table& table, uint32_t id) {
+        for (auto it = table.begin(); it != table.end(); ) {
+            const auto& vars = it->second.vars;
+            if (std::find(vars.begin(), vars.end(), id) != vars.end()) it = table.erase(it); else ++it;
+        }
+    }
+
+    static void kill_memory(Table& table, int type) {
+        for (auto it = table.begin(); it != table.end(); ) {
+            int mem = it->second.mem;
+            if (mem >= 0 && (type < 0 || mem == type)) it = table.erase(it); else ++it;
+        }
+    }
+
+    bool number_block(BasicBlock& bb, Table& table) {
+        std::vector<bool> erase(bb.insts.size(), false);
+        bool changed = false;
+        for (size_t i = 0; i < bb.insts.size(); ++i) {
+            Inst& inst = bb.insts[i];
+            std::string key = key_of(inst);
+            const VarId* def = inst_def(inst);
+            bool redundant = false;
+            if (!key.empty()) {
+                auto it = table.find(key);
+                if (it != table.end()) {
+                    redundant = changed = true;
+                    // Recomputing into the variable that already holds it is a no-op
+                    if (it->second.holder == *def) {
+                        erase[i] = true;
+                        continue;
+                    }
+                    inst = Copy{*def, it->second.holder};
+                    def = inst_def(inst);
+                }
+            }
+
+            if (auto* store = std::get_if<Store>(&inst)) kill_memory(table, pointee_type(store->dst));
+            else if (std::holds_alternative<Call>(inst)) kill_memory(table, -1);
+            uint32_t def_id = def ? m_vars.id(*def) : VarIndex::NONE;
+            if (def_id != VarIndex::NONE) kill_var(table, def_id);
+
+            if (key.empty() || redundant || def_id == VarIndex::NONE) continue;
+            Available avail{*def, {def_id}};
+            bool reads_def = false;
+            for_each_use(inst, [&](const VarId& v) {
+                uint32_t id = m_vars.id(v);
+                if (id == def_id) reads_def = true;
+                if (id != VarIndex::NONE) avail.vars.push_back(id);
+            });
+            // `a = $arith add a b` no longer computes `add a b` afterwards
+            if (reads_def) continue;
+            if (auto* load = std::get_if<Load>(&inst)) avail.mem = pointee_type(load->src);
+            table.emplace(std::move(key), std::move(avail));
+        }
+
+        if (std::find(erase.begin(), erase.end(), true) != erase.end()) {
+            size_t kept = 0;
+            for (size_t i = 0; i < bb.insts.size(); ++i) {
+                if (erase[i]) continue;
+                if (kept != i) bb.insts[kept] = std::move(bb.insts[i]);
+                kept++;
+            }
+            bb.insts.resize(kept);
+        }
+        return changed;
+    }
+
+    Function& m_fn;
+    const CFGInfo& m_cfg;
+    const DomTree& m_dom;
+    VarIndex m_vars;
+    std::map<BbId, Clobbers> m_clobbers;
+    std::unordered_map<std::string, int> m_type_ids;
+};
+
+class GvnPass : public FunctionPass {
+public:
+    const char* name() const override { return "gvn"; }
+    bool preserves_cfg() const override { return true; }
+    bool run(Function& fn, PassContext& ctx) override {
+        GlobalValueNumbering gvn(fn, ctx.am.get<CFGInfo>(fn), ctx.am.get<DomTree>(fn));
+        return gvn.run();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> create_gvn_pass() { return std::make_unique<GvnPass>(); }
+
+} // namespace LIR
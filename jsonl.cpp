@@ -0,0 +1,115 @@
+#include "jsonl.hpp"
+#include "ast.hpp"
+#include "lir_verifier.hpp"
+#include "pass_manager.hpp"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Programs in flight per thread: enough to even out their sizes
+constexpr size_t WINDOW_PER_THREAD = 16;
+
+// A worker's lowerer and pass manager, reused for every program it takes
+struct Worker {
+    explicit Worker(const BatchOptions& options)
+        : lowerer(options.lower), pm(LIR::build_pipeline(options.opt_level, 1, options.fuse_branch_cmp)) {}
+
+    Lowerer lowerer;
+    LIR::PassManager pm;
+};
+
+void lower_line(const std::string& line, Worker& worker, const BatchOptions& options, std::string& text) {
+    std::unique_ptr<AST::Program> ast;
+    {
+        nlohmann::json j = nlohmann::json::parse(line);
+        ast = buildProgram(j);
+    }
+    std::unique_ptr<LIR::Program> prog = worker.lowerer.lower(ast.get());
+    ast.reset();
+    if (options.verify) LIR::verify(*prog);
+    worker.pm.run(*prog);
+    if (options.verify) LIR::verify(*prog);
+
+    LIR::render_header(*prog, text);
+    for (const auto& [name, fn] : prog->functions) LIR::render_function(fn, text);
+}
+
+} // namespace
+
+size_t run_jsonl(std::istream& in, LIR::LirEmitter& out, const BatchOptions& options, JsonlFraming framing) {
+    if (options.format != OutputFormat::Text) throw std::runtime_error("--jsonl only writes text output");
+
+    ThreadPool pool(options.threads);
+    std::vector<std::unique_ptr<Worker>> workers(pool.size());
+    const size_t window = WINDOW_PER_THREAD * pool.size();
+
+    std::vector<std::string> lines;
+    std::vector<size_t> line_numbers;
+    std::vector<std::string> texts(window);
+    std::vector<std::string> errors(window);
+    size_t lineno = 0;
+    size_t failed = 0;
+    for (bool more = true; more;) {
+        lines.clear();
+        line_numbers.clear();
+        std::string line;
+        while (lines.size() < window) {
+            if (!std::getline(in, line)) {
+                more = false;
+                break;
+            }
+            ++lineno;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            lines.push_back(std::move(line));
+            line_numbers.push_back(lineno);
+        }
+
+        pool.parallel_for(lines.size(), [&](size_t i, size_t w) {
+            if (!workers[w]) workers[w] = std::make_unique<Worker>(options);
+            texts[i].clear();
+            errors[i].clear();
+            try {
+                lower_line(lines[i], *workers[w], options, texts[i]);
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+                texts[i].clear();
+                // A lowering cut short may leave state behind; keep the timings
+                workers[w]->lowerer = Lowerer(options.lower);
+            }
+            std::string().swap(lines[i]);
+        });
+
+        // In input order, whatever order the programs finished in
+        for (size_t i = 0; i < lines.size(); ++i) {
+            std::string number = std::to_string(line_numbers[i]);
+            if (!errors[i].empty()) {
+                std::cerr << "Error: line " << number << ": " << errors[i] << "\n";
+                ++failed;
+            }
+            if (framing == JsonlFraming::Separator) {
+                out.append("\x1e");
+                out.append(texts[i]);
+            } else {
+                bool ok = errors[i].empty();
+                out.append("{\"line\": " + number + (ok ? ", \"lir\": " : ", \"error\": "));
+                // Parse errors quote the input, which need not be valid UTF-8
+                out.append(nlohmann::json(ok ? texts[i] : errors[i])
+                               .dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+                out.append("}\n");
+            }
+        }
+    }
+
+    if (options.time_passes) {
+        std::vector<const LIR::PassManager*> pms;
+        for (const auto& worker : workers) {
+            if (worker) pms.push_back(&worker->pm);
+        }
+        LIR::PassManager::print_report(std::cerr, pms);
+    }
+    return failed;
+}
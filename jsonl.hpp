@@ -0,0 +1,25 @@
+#pragma once
+
+#include "batch.hpp"
+#include "lir_emitter.hpp"
+#include <istream>
+
+// JSON Lines input (--jsonl): a stream with one AST program per line, as
+// generators emit thousands of small programs. Programs are read a window at
+// a time (a few per thread), lowered and optimized in parallel, and written
+// in input order before the next window is read, so memory stays bounded
+// however long the stream is. Blank lines are skipped.
+
+enum class JsonlFraming {
+    // RFC 7464 style: each program's LIR text is preceded by an ASCII record
+    // separator (0x1e); a program that failed leaves an empty record
+    Separator,
+    // One JSON object per line: {"line": N, "lir": "..."}, or
+    // {"line": N, "error": "..."} for a program that failed
+    Records,
+};
+
+// Lowers every program of `in` (text output only) into `out`. Errors are
+// reported on stderr with their line number; returns how many programs
+// failed.
+size_t run_jsonl(std::istream& in, LIR::LirEmitter& out, const BatchOptions& options, JsonlFraming framing);
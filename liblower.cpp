@@ -0,0 +1,92 @@
+#include "liblower.hpp"
+#include "ast.hpp"
+#include "lir_binary.hpp"
+#include "lir_reader.hpp"
+#include "lir_verifier.hpp"
+#include "pass_manager.hpp"
+#include <stdexcept>
+
+namespace {
+
+// Runs the steps of a lowering, turning the exception of a failed one into
+// the result's error
+std::unique_ptr<LIR::Program> run_steps(std::string_view input, const LibraryOptions& options,
+                                        LowerResult& result) {
+    const char* step = "parse";
+    try {
+        std::unique_ptr<LIR::Program> prog;
+        InputFormat format = options.input == InputFormat::Detect ? detect_input_format(input) : options.input;
+        switch (format) {
+            case InputFormat::Lir:
+                prog = std::make_unique<LIR::Program>(LIR::parse_lir(input));
+                break;
+            case InputFormat::Lirb:
+                prog = std::make_unique<LIR::Program>(LIR::LirbFile(input.data(), input.size()).read_program());
+                break;
+            case InputFormat::Json:
+            case InputFormat::Cbor:
+            case InputFormat::MsgPack:
+            case InputFormat::Detect: {
+                nlohmann::json j = format == InputFormat::Cbor      ? nlohmann::json::from_cbor(input)
+                                   : format == InputFormat::MsgPack ? nlohmann::json::from_msgpack(input)
+                                                                    : nlohmann::json::parse(input);
+                // A badly shaped AST is a parse error too
+                std::unique_ptr<AST::Program> ast = buildProgram(j);
+                step = "lower";
+                Lowerer lowerer(options.lower);
+                prog = lowerer.lower(ast.get());
+                break;
+            }
+        }
+
+        step = "verify";
+        if (options.verify) LIR::verify(*prog);
+        step = "optimize";
+        LIR::PassManager pm = LIR::build_pipeline(options.opt_level, options.threads, options.lower.fuse_branch_cmp);
+        pm.run(*prog);
+        step = "verify";
+        if (options.verify) LIR::verify(*prog);
+        return prog;
+    } catch (const std::exception& e) {
+        result.error = std::string(step) + ": " + e.what();
+        return nullptr;
+    }
+}
+
+} // namespace
+
+InputFormat detect_input_format(std::string_view input) {
+    if (input.substr(0, 4) == "LIRB") return InputFormat::Lirb;
+    if (input.empty()) return InputFormat::Lir;
+    auto first = static_cast<unsigned char>(input[0]);
+    if (first >= 0xa0 && first <= 0xbf) return InputFormat::Cbor;
+    if ((first >= 0x80 && first <= 0x8f) || first == 0xde || first == 0xdf) return InputFormat::MsgPack;
+    size_t start = input.find_first_not_of(" \t\r\n");
+    if (start != std::string_view::npos && input[start] == '{') return InputFormat::Json;
+    return InputFormat::Lir;
+}
+
+LowerResult lower_to_program(std::string_view input, const LibraryOptions& options) {
+    LowerResult result;
+    result.program = run_steps(input, options, result);
+    return result;
+}
+
+LowerResult lower_to_buffer(std::string_view input, const LibraryOptions& options) {
+    LowerResult result;
+    std::unique_ptr<LIR::Program> prog = run_steps(input, options, result);
+    if (!prog) return result;
+    try {
+        LIR::LirEmitter emitter(result.output);
+        std::unique_ptr<ThreadPool> pool;
+        if (options.threads > 1 && options.output == OutputFormat::Text) {
+            pool = std::make_unique<ThreadPool>(options.threads);
+        }
+        emit_program(*prog, options.output, emitter, pool.get());
+        emitter.flush();
+    } catch (const std::exception& e) {
+        result.output.clear();
+        result.error = std::string("output: ") + e.what();
+    }
+    return result;
+}
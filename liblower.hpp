@@ -0,0 +1,60 @@
+#pragma once
+
+#include "batch.hpp"
+#include "lir.hpp"
+#include "lowerer.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Embedding API, built as liblower.a: lowers input bytes inside a host
+// process instead of piping files through the lower executable.
+//
+// Calls share no state, so any number of them may run at once on different
+// threads. Nothing is printed: a failure comes back as the result's error.
+//
+//     LibraryOptions options;
+//     options.opt_level = 2;
+//     LowerResult result = lower_to_buffer(ast_json, options);
+//     if (!result.ok()) report(result.error);
+//     else use(result.output);
+
+enum class InputFormat {
+    Detect,  // from the first bytes, see detect_input_format()
+    Json,    // AST as JSON, as in .astj files
+    Cbor,    // the same AST document encoded as CBOR
+    MsgPack, // ... or as MessagePack
+    Lir,     // LIR text (lir_reader.hpp)
+    Lirb,    // binary LIR (lir_binary.hpp)
+};
+
+struct LibraryOptions {
+    LowerOptions lower;
+    int opt_level = 0;
+    bool verify = false;
+    InputFormat input = InputFormat::Detect;
+    OutputFormat output = OutputFormat::Text;
+    // Threads for the function passes and text rendering of one call
+    size_t threads = 1;
+};
+
+struct LowerResult {
+    // Empty on success; otherwise the step that failed and why
+    std::string error;
+    // Set by lower_to_program()
+    std::unique_ptr<LIR::Program> program;
+    // Set by lower_to_buffer(), in LibraryOptions::output
+    std::string output;
+
+    bool ok() const { return error.empty(); }
+};
+
+// Parses (or lowers) `input` and runs the pipeline of `options.opt_level`
+LowerResult lower_to_program(std::string_view input, const LibraryOptions& options = {});
+
+// The same, rendered as lower would print it
+LowerResult lower_to_buffer(std::string_view input, const LibraryOptions& options = {});
+
+// Lirb starts with its magic number, a CBOR or MessagePack AST with a map
+// header, and a JSON AST with '{'; anything else is taken for LIR text.
+InputFormat detect_input_format(std::string_view input);
@@ -153,6 +153,34 @@ using FieldId = std::string;
 enum class ArithOp { Add, Sub, Mul, Div };
 enum class RelOp { Eq, NotEq, Lt, Lte, Gt, Gte };
 
+// Every operator, for mapping a spelling back to it
+inline constexpr ArithOp ARITH_OPS[] = {ArithOp::Add, ArithOp::Sub, ArithOp::Mul, ArithOp::Div};
+inline constexpr RelOp REL_OPS[] = {RelOp::Eq, RelOp::NotEq, RelOp::Lt, RelOp::Lte, RelOp::Gt, RelOp::Gte};
+
+// Spelling of an operator in LIR text, shared by the printers, the JSON
+// export and the reader
+inline const char* arith_name(ArithOp op) {
+    switch (op) {
+        case ArithOp::Add: return "add";
+        case ArithOp::Sub: return "sub";
+        case ArithOp::Mul: return "mul";
+        case ArithOp::Div: return "div";
+    }
+    return "";
+}
+
+inline const char* rel_name(RelOp op) {
+    switch (op) {
+        case RelOp::Eq:    return "eq";
+        case RelOp::NotEq: return "ne";
+        case RelOp::Lt:    return "lt";
+        case RelOp::Lte:   return "lte";
+        case RelOp::Gt:    return "gt";
+        case RelOp::Gte:   return "gte";
+    }
+    return "";
+}
+
 // --- Instructions (Inst) ---
 struct Const { VarId lhs; int val; };
 struct Copy { VarId lhs; VarId op; };
@@ -165,17 +193,19 @@ struct Gep { VarId lhs; VarId src; VarId idx; bool checked; };     // GetElement
 struct AllocSingle { VarId lhs; TypePtr typ; }; // Changed to use LIR::Type
 struct AllocArray { VarId lhs; VarId amt; TypePtr typ; }; // Changed to use LIR::Type
 struct Call { std::optional<VarId> lhs; VarId callee; std::vector<VarId> args; };
+struct Select { VarId lhs; VarId guard; VarId tt; VarId ff; }; // lhs = guard != 0 ? tt : ff, without branching
 
 using Inst = std::variant<
-    Const, Copy, Arith, Cmp, Load, Store, Gfp, Gep, AllocSingle, AllocArray, Call
+    Const, Copy, Arith, Cmp, Load, Store, Gfp, Gep, AllocSingle, AllocArray, Call, Select
 >;
 
 // --- Terminals ---
 struct Jump { BbId target; };
 struct Branch { VarId guard; BbId tt; BbId ff; };
 struct Ret { std::optional<VarId> val; }; // Using optional for return; vs return x;
+struct BranchCmp { RelOp rop; VarId left; VarId right; BbId tt; BbId ff; }; // Branch on `left rop right`
 
-using Terminal = std::variant<std::monostate, Jump, Branch, Ret>;
+using Terminal = std::variant<std::monostate, Jump, Branch, Ret, BranchCmp>;
 
 // --- Core Structures ---
 struct BasicBlock {
@@ -213,27 +243,9 @@ struct Program {
 
 // --- LIR Printers ---
 
-inline std::ostream& operator<<(std::ostream& os, ArithOp op) {
-    switch (op) {
-        case ArithOp::Add: return os << "add";
-        case ArithOp::Sub: return os << "sub";
-        case ArithOp::Mul: return os << "mul";
-        case ArithOp::Div: return os << "div";
-    }
-    return os;
-}
+inline std::ostream& operator<<(std::ostream& os, ArithOp op) { return os << arith_name(op); }
 
-inline std::ostream& operator<<(std::ostream& os, RelOp op) {
-    switch (op) {
-        case RelOp::Eq:    return os << "eq";
-        case RelOp::NotEq: return os << "ne";
-        case RelOp::Lt:    return os << "lt";
-        case RelOp::Lte:   return os << "lte";
-        case RelOp::Gt:    return os << "gt";
-        case RelOp::Gte:   return os << "gte";
-    }
-    return os;
-}
+inline std::ostream& operator<<(std::ostream& os, RelOp op) { return os << rel_name(op); }
 
 inline std::ostream& operator<<(std::ostream& os, const Inst& inst) {
     os << "  "; // Indentation
@@ -269,6 +281,8 @@ inline std::ostream& operator<<(std::ostream& os, const Inst& inst) {
             }
             os << ")";
         }
+        else if constexpr (std::is_same_v<T, Select>)
+            os << arg.lhs << " = $select " << arg.guard << " " << arg.tt << " " << arg.ff;
     }, inst);
     return os << "\n";
 }
@@ -285,6 +299,8 @@ inline std::ostream& operator<<(std::ostream& os, const Terminal& term) {
             os << "$ret";
             if (arg.val) os << " " << *arg.val;
         }
+        else if constexpr (std::is_same_v<T, BranchCmp>)
+            os << "$branch_cmp " << arg.rop << " " << arg.left << " " << arg.right << " " << arg.tt << " " << arg.ff;
         else if constexpr (std::is_same_v<T, std::monostate>)
             os << "$unreachable"; // Should not happen in valid Cflat
     }, term);
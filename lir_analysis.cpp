@@ -0,0 +1,103 @@
+#include "lir_analysis.hpp"
+#include "lir_utils.hpp"
+#include <algorithm>
+#include <set>
+
+namespace LIR {
+
+CFGInfo CFGInfo::compute(const Function& fn) {
+    CFGInfo cfg;
+    for (const auto& [label, bb] : fn.body) {
+        cfg.preds[label]; // every block gets an (possibly empty) entry
+        for (const auto& succ : successors(bb.term)) {
+            if (!fn.body.count(succ)) continue;
+            auto& out = cfg.succs[label];
+            // A branch with tt == ff is a single edge
+            if (std::find(out.begin(), out.end(), succ) != out.end()) continue;
+            out.push_back(succ);
+            cfg.preds[succ].push_back(label);
+        }
+        cfg.succs[label];
+    }
+
+    // Iterative DFS for the postorder, then reverse it
+    if (!fn.body.count("entry")) return cfg;
+    std::set<BbId> visited;
+    std::vector<std::pair<BbId, size_t>> stack;
+    stack.push_back({"entry", 0});
+    visited.insert("entry");
+    while (!stack.empty()) {
+        auto& [label, next] = stack.back();
+        const auto& out = cfg.succs[label];
+        if (next < out.size()) {
+            const BbId& succ = out[next++];
+            if (visited.insert(succ).second) {
+                stack.push_back({succ, 0});
+            }
+        } else {
+            cfg.rpo.push_back(label);
+            stack.pop_back();
+        }
+    }
+    std::reverse(cfg.rpo.begin(), cfg.rpo.end());
+    return cfg;
+}
+
+DomTree DomTree::compute(const Function& fn) {
+    CFGInfo cfg = CFGInfo::compute(fn);
+    DomTree dom;
+    dom.rpo = cfg.rpo;
+    const size_t n = cfg.rpo.size();
+    if (n == 0) return dom;
+
+    std::map<BbId, size_t> index;
+    for (size_t i = 0; i < n; ++i) index[cfg.rpo[i]] = i;
+    const size_t UNDEF = n;
+    std::vector<size_t> idom(n, UNDEF);
+    idom[0] = 0;
+
+    auto intersect = [&](size_t a, size_t b) {
+        while (a != b) {
+            while (a > b) a = idom[a];
+            while (b > a) b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = 1; b < n; ++b) {
+            size_t new_idom = UNDEF;
+            for (const auto& pred : cfg.preds.at(cfg.rpo[b])) {
+                auto it = index.find(pred);
+                if (it == index.end() || idom[it->second] == UNDEF) continue;
+                new_idom = new_idom == UNDEF ? it->second : intersect(it->second, new_idom);
+            }
+            if (new_idom != idom[b]) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (size_t b = 0; b < n; ++b) {
+        dom.idom[cfg.rpo[b]] = cfg.rpo[idom[b]];
+        dom.children[cfg.rpo[b]];
+        if (b != 0) dom.children[cfg.rpo[idom[b]]].push_back(cfg.rpo[b]);
+    }
+    return dom;
+}
+
+bool DomTree::dominates(const BbId& a, const BbId& b) const {
+    auto it = idom.find(b);
+    if (it == idom.end()) return false;
+    BbId cur = b;
+    while (true) {
+        if (cur == a) return true;
+        const BbId& up = idom.at(cur);
+        if (up == cur) return false;
+        cur = up;
+    }
+}
+
+} // namespace LIR
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "lir.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+// Analyses over LIR::Function that passes can request (and have cached)
+// through the LIR::AnalysisManager in pass_manager.hpp.
+//
+// Every analysis provides:
+//   static constexpr bool cfg_only  -- true if it only depends on the block
+//                                      graph, so it survives passes that only
+//                                      rewrite instructions
+//   static X compute(const Function& fn)
+
+namespace LIR {
+
+// Successor/predecessor lists and a reverse postorder of the blocks
+// reachable from `entry`.
+struct CFGInfo {
+    static constexpr bool cfg_only = true;
+
+    std::map<BbId, std::vector<BbId>> succs;
+    std::map<BbId, std::vector<BbId>> preds;
+    std::vector<BbId> rpo;
+
+    static CFGInfo compute(const Function& fn);
+};
+
+// Immediate dominators of the reachable blocks (Cooper, Harvey and Kennedy's
+// iterative algorithm over the reverse postorder).
+struct DomTree {
+    static constexpr bool cfg_only = true;
+
+    std::vector<BbId> rpo;
+    std::map<BbId, BbId> idom; // entry is its own idom
+    std::map<BbId, std::vector<BbId>> children; // in reverse postorder
+
+    // True if every path from entry to `b` goes through `a` (a block dominates itself)
+    bool dominates(const BbId& a, const BbId& b) const;
+
+    static DomTree compute(const Function& fn);
+};
+
+} // namespace LIR
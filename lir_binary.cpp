@@ -0,0 +1,594 @@
+#include "lir_binary.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace LIR {
+
+namespace {
+
+constexpr char MAGIC[4] = {'L', 'I', 'R', 'B'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 48;
+
+enum class TypeKind : uint8_t { Int, Nil, Struct, Array, Ptr, Fn, Null };
+
+// --- Encoding ---
+
+void put_u8(std::string& out, uint8_t v) { out += static_cast<char>(v); }
+
+void put_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+void put_u64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+void patch_u64(std::string& out, size_t at, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out[at + i] = static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+class Encoder {
+public:
+    std::string encode(const Program& prog) {
+        // Functions first: the string and type tables must be complete
+        // before they are written
+        std::vector<std::string> records;
+        for (const auto& [name, fn] : prog.functions) {
+            records.emplace_back();
+            put_function(fn, records.back());
+        }
+        std::string module;
+        put_module(prog, module);
+        std::vector<uint32_t> fn_names;
+        for (const auto& [name, fn] : prog.functions) fn_names.push_back(str(name));
+
+        std::string out(HEADER_SIZE, '\0');
+        std::memcpy(&out[0], MAGIC, sizeof(MAGIC));
+        for (int i = 0; i < 4; ++i) out[4 + i] = static_cast<char>((VERSION >> (8 * i)) & 0xff);
+
+        patch_u64(out, 8, out.size());
+        put_u32(out, static_cast<uint32_t>(m_strings.size()));
+        uint32_t offset = 0;
+        for (const auto* s : m_strings) {
+            put_u32(out, offset);
+            offset += static_cast<uint32_t>(s->size());
+        }
+        put_u32(out, offset);
+        for (const auto* s : m_strings) out += *s;
+
+        patch_u64(out, 16, out.size());
+        put_u32(out, m_type_count);
+        out += m_types;
+
+        patch_u64(out, 24, out.size());
+        out += module;
+
+        patch_u64(out, 32, out.size());
+        put_u32(out, static_cast<uint32_t>(records.size()));
+        uint64_t fn_offset = out.size() + records.size() * 20;
+        for (size_t i = 0; i < records.size(); ++i) {
+            put_u32(out, fn_names[i]);
+            put_u64(out, fn_offset);
+            put_u64(out, records[i].size());
+            fn_offset += records[i].size();
+        }
+        for (const auto& rec : records) out += rec;
+        patch_u64(out, 40, out.size());
+        return out;
+    }
+
+private:
+    uint32_t str(const std::string& s) {
+        auto [it, inserted] = m_string_ids.emplace(s, static_cast<uint32_t>(m_strings.size()));
+        if (inserted) m_strings.push_back(&it->first);
+        return it->second;
+    }
+
+    // Types are keyed by their printed form, which identifies them uniquely
+    uint32_t type(const TypePtr& t) {
+        std::string key;
+        if (t) {
+            std::ostringstream os;
+            t->print(os);
+            key = os.str();
+        }
+        auto it = m_type_ids.find(key);
+        if (it != m_type_ids.end()) return it->second;
+
+        // Element types are written (and so numbered) before the type itself
+        std::string rec;
+        if (!t) {
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Null));
+        } else if (dynamic_cast<const IntType*>(t.get())) {
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Int));
+        } else if (dynamic_cast<const NilType*>(t.get())) {
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Nil));
+        } else if (auto* s = dynamic_cast<const StructType*>(t.get())) {
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Struct));
+            put_u32(rec, str(s->id));
+        } else if (auto* a = dynamic_cast<const ArrayType*>(t.get())) {
+            uint32_t elem = type(a->element);
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Array));
+            put_u32(rec, elem);
+        } else if (auto* p = dynamic_cast<const PtrType*>(t.get())) {
+            uint32_t elem = type(p->element);
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Ptr));
+            put_u32(rec, elem);
+        } else if (auto* fn = dynamic_cast<const FnType*>(t.get())) {
+            std::vector<uint32_t> params;
+            for (const auto& param : fn->params) params.push_back(type(param));
+            uint32_t ret = type(fn->ret);
+            put_u8(rec, static_cast<uint8_t>(TypeKind::Fn));
+            put_u32(rec, ret);
+            put_u32(rec, static_cast<uint32_t>(params.size()));
+            for (uint32_t param : params) put_u32(rec, param);
+        } else {
+            throw std::runtime_error("lirb: cannot encode type " + key);
+        }
+        m_types += rec;
+        uint32_t id = m_type_count++;
+        m_type_ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    void put_str(std::string& out, const std::string& s) { put_u32(out, str(s)); }
+    void put_type(std::string& out, const TypePtr& t) { put_u32(out, type(t)); }
+
+    void put_typed_names(std::string& out, const std::map<std::string, TypePtr>& entries) {
+        put_u32(out, static_cast<uint32_t>(entries.size()));
+        for (const auto& [name, typ] : entries) {
+            put_str(out, name);
+            put_type(out, typ);
+        }
+    }
+
+    void put_module(const Program& prog, std::string& out) {
+        put_u32(out, static_cast<uint32_t>(prog.structs.size()));
+        for (const auto& [name, s] : prog.structs) {
+            put_str(out, name);
+            put_typed_names(out, s.fields);
+        }
+        put_typed_names(out, prog.externs);
+        put_typed_names(out, prog.funptrs);
+    }
+
+    void put_inst(std::string& out, const Inst& inst) {
+        put_u8(out, static_cast<uint8_t>(inst.index()));
+        std::visit([&](const auto& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, Const>) {
+                put_str(out, arg.lhs);
+                put_u32(out, static_cast<uint32_t>(arg.val));
+            } else if constexpr (std::is_same_v<T, Copy>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.op);
+            } else if constexpr (std::is_same_v<T, Arith>) {
+                put_str(out, arg.lhs);
+                put_u8(out, static_cast<uint8_t>(arg.aop));
+                put_str(out, arg.left);
+                put_str(out, arg.right);
+            } else if constexpr (std::is_same_v<T, Cmp>) {
+                put_str(out, arg.lhs);
+                put_u8(out, static_cast<uint8_t>(arg.rop));
+                put_str(out, arg.left);
+                put_str(out, arg.right);
+            } else if constexpr (std::is_same_v<T, Load>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.src);
+            } else if constexpr (std::is_same_v<T, Store>) {
+                put_str(out, arg.dst);
+                put_str(out, arg.op);
+            } else if constexpr (std::is_same_v<T, Gfp>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.src);
+                put_str(out, arg.sid);
+                put_str(out, arg.field);
+            } else if constexpr (std::is_same_v<T, Gep>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.src);
+                put_str(out, arg.idx);
+                put_u8(out, arg.checked);
+            } else if constexpr (std::is_same_v<T, AllocSingle>) {
+                put_str(out, arg.lhs);
+                put_type(out, arg.typ);
+            } else if constexpr (std::is_same_v<T, AllocArray>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.amt);
+                put_type(out, arg.typ);
+            } else if constexpr (std::is_same_v<T, Call>) {
+                put_u8(out, arg.lhs.has_value());
+                if (arg.lhs) put_str(out, *arg.lhs);
+                put_str(out, arg.callee);
+                put_u32(out, static_cast<uint32_t>(arg.args.size()));
+                for (const auto& a : arg.args) put_str(out, a);
+            } else if constexpr (std::is_same_v<T, Select>) {
+                put_str(out, arg.lhs);
+                put_str(out, arg.guard);
+                put_str(out, arg.tt);
+                put_str(out, arg.ff);
+            }
+        }, inst);
+    }
+
+    void put_terminal(std::string& out, const Terminal& term) {
+        put_u8(out, static_cast<uint8_t>(term.index()));
+        std::visit([&](const auto& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, Jump>) {
+                put_str(out, arg.target);
+            } else if constexpr (std::is_same_v<T, Branch>) {
+                put_str(out, arg.guard);
+                put_str(out, arg.tt);
+                put_str(out, arg.ff);
+            } else if constexpr (std::is_same_v<T, Ret>) {
+                put_u8(out, arg.val.has_value());
+                if (arg.val) put_str(out, *arg.val);
+            } else if constexpr (std::is_same_v<T, BranchCmp>) {
+                put_u8(out, static_cast<uint8_t>(arg.rop));
+                put_str(out, arg.left);
+                put_str(out, arg.right);
+                put_str(out, arg.tt);
+                put_str(out, arg.ff);
+            }
+        }, term);
+    }
+
+    void put_function(const Function& fn, std::string& out) {
+        put_str(out, fn.name);
+        put_type(out, fn.rettyp);
+        put_u32(out, static_cast<uint32_t>(fn.params.size()));
+        for (const auto& [name, typ] : fn.params) {
+            put_str(out, name);
+            put_type(out, typ);
+        }
+        put_typed_names(out, fn.locals);
+        put_u32(out, static_cast<uint32_t>(fn.body.size()));
+        for (const auto& [label, bb] : fn.body) {
+            put_str(out, label);
+            put_u32(out, static_cast<uint32_t>(bb.insts.size()));
+            for (const auto& inst : bb.insts) put_inst(out, inst);
+            put_terminal(out, bb.term);
+        }
+    }
+
+    std::unordered_map<std::string, uint32_t> m_string_ids;
+    std::vector<const std::string*> m_strings; // keys of m_string_ids, by id
+    std::unordered_map<std::string, uint32_t> m_type_ids;
+    std::string m_types;
+    uint32_t m_type_count = 0;
+};
+
+// --- Decoding ---
+
+[[noreturn]] void corrupt(const std::string& what) {
+    throw std::runtime_error("lirb: corrupt file (" + what + ")");
+}
+
+class Cursor {
+public:
+    Cursor(std::string_view bytes, uint64_t offset, uint64_t size) {
+        if (offset > bytes.size() || size > bytes.size() - offset) corrupt("section out of range");
+        m_p = bytes.data() + offset;
+        m_end = m_p + size;
+    }
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(*m_p++);
+    }
+    uint32_t u32() {
+        need(4);
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(m_p[i])) << (8 * i);
+        m_p += 4;
+        return v;
+    }
+    uint64_t u64() {
+        need(8);
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(m_p[i])) << (8 * i);
+        m_p += 8;
+        return v;
+    }
+    std::string_view bytes(size_t n) {
+        need(n);
+        std::string_view v(m_p, n);
+        m_p += n;
+        return v;
+    }
+    // A record count, checked against the bytes left so that corrupt counts
+    // are reported before anything is allocated for them
+    uint32_t count(size_t min_record_size) {
+        uint32_t n = u32();
+        if (static_cast<uint64_t>(n) * min_record_size > static_cast<uint64_t>(m_end - m_p)) corrupt("count");
+        return n;
+    }
+
+private:
+    void need(size_t n) const {
+        if (static_cast<size_t>(m_end - m_p) < n) corrupt("truncated");
+    }
+
+    const char* m_p;
+    const char* m_end;
+};
+
+// Decodes records that refer to the string and type tables
+class Decoder {
+public:
+    Decoder(Cursor& in, const std::vector<std::string_view>& strings, const std::vector<TypePtr>& types)
+        : m_in(in), m_strings(strings), m_types(types) {}
+
+    std::string str() {
+        uint32_t id = m_in.u32();
+        if (id >= m_strings.size()) corrupt("string id");
+        return std::string(m_strings[id]);
+    }
+    TypePtr type() {
+        uint32_t id = m_in.u32();
+        if (id >= m_types.size()) corrupt("type id");
+        return m_types[id];
+    }
+    template <typename E>
+    E op(E last) {
+        uint8_t v = m_in.u8();
+        if (v > static_cast<uint8_t>(last)) corrupt("operator");
+        return static_cast<E>(v);
+    }
+
+    std::map<std::string, TypePtr> typed_names() {
+        std::map<std::string, TypePtr> out;
+        uint32_t n = m_in.count(8);
+        for (uint32_t i = 0; i < n; ++i) {
+            std::string name = str();
+            out.emplace_hint(out.end(), std::move(name), type());
+        }
+        return out;
+    }
+
+    Inst inst() {
+        switch (m_in.u8()) {
+            case 0: { Const c; c.lhs = str(); c.val = static_cast<int>(m_in.u32()); return c; }
+            case 1: { Copy c; c.lhs = str(); c.op = str(); return c; }
+            case 2: {
+                Arith a;
+                a.lhs = str();
+                a.aop = op(ArithOp::Div);
+                a.left = str();
+                a.right = str();
+                return a;
+            }
+            case 3: {
+                Cmp c;
+                c.lhs = str();
+                c.rop = op(RelOp::Gte);
+                c.left = str();
+                c.right = str();
+                return c;
+            }
+            case 4: { Load l; l.lhs = str(); l.src = str(); return l; }
+            case 5: { Store s; s.dst = str(); s.op = str(); return s; }
+            case 6: { Gfp g; g.lhs = str(); g.src = str(); g.sid = str(); g.field = str(); return g; }
+            case 7: { Gep g; g.lhs = str(); g.src = str(); g.idx = str(); g.checked = m_in.u8() != 0; return g; }
+            case 8: { AllocSingle a; a.lhs = str(); a.typ = type(); return a; }
+            case 9: { AllocArray a; a.lhs = str(); a.amt = str(); a.typ = type(); return a; }
+            case 10: {
+                Call c;
+                if (m_in.u8()) c.lhs = str();
+                c.callee = str();
+                uint32_t n = m_in.count(4);
+                for (uint32_t i = 0; i < n; ++i) c.args.push_back(str());
+                return c;
+            }
+            case 11: { Select s; s.lhs = str(); s.guard = str(); s.tt = str(); s.ff = str(); return s; }
+            default: corrupt("opcode");
+        }
+    }
+
+    Terminal terminal() {
+        switch (m_in.u8()) {
+            case 0: return std::monostate{};
+            case 1: { Jump j; j.target = str(); return j; }
+            case 2: { Branch b; b.guard = str(); b.tt = str(); b.ff = str(); return b; }
+            case 3: { Ret r; if (m_in.u8()) r.val = str(); return r; }
+            case 4: {
+                BranchCmp b;
+                b.rop = op(RelOp::Gte);
+                b.left = str();
+                b.right = str();
+                b.tt = str();
+                b.ff = str();
+                return b;
+            }
+            default: corrupt("terminal");
+        }
+    }
+
+    Function function() {
+        Function fn;
+        fn.name = str();
+        fn.rettyp = type();
+        uint32_t nparams = m_in.count(8);
+        for (uint32_t i = 0; i < nparams; ++i) {
+            std::string name = str();
+            fn.params.emplace_back(std::move(name), type());
+        }
+        fn.locals = typed_names();
+        // Label, instruction count and terminal kind
+        uint32_t nblocks = m_in.count(9);
+        for (uint32_t b = 0; b < nblocks; ++b) {
+            BasicBlock bb;
+            bb.label = str();
+            uint32_t ninsts = m_in.count(1);
+            bb.insts.reserve(ninsts);
+            for (uint32_t i = 0; i < ninsts; ++i) bb.insts.push_back(inst());
+            bb.term = terminal();
+            BbId label = bb.label;
+            fn.body.emplace_hint(fn.body.end(), std::move(label), std::move(bb));
+        }
+        return fn;
+    }
+
+private:
+    Cursor& m_in;
+    const std::vector<std::string_view>& m_strings;
+    const std::vector<TypePtr>& m_types;
+};
+
+} // namespace
+
+// --- Writer ---
+
+std::string encode_lirb(const Program& prog) {
+    return Encoder().encode(prog);
+}
+
+// --- Reader ---
+
+LirbFile::LirbFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("lirb: cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("lirb: cannot stat " + path);
+    }
+    m_map_size = static_cast<size_t>(st.st_size);
+    if (m_map_size > 0) {
+        m_map = ::mmap(nullptr, m_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (m_map == MAP_FAILED) {
+        m_map = nullptr;
+        throw std::runtime_error("lirb: cannot map " + path);
+    }
+    m_bytes = std::string_view(static_cast<const char*>(m_map), m_map_size);
+    try {
+        load();
+    } catch (...) {
+        if (m_map) ::munmap(m_map, m_map_size);
+        throw;
+    }
+}
+
+LirbFile::LirbFile(const char* data, size_t size) : m_bytes(data, size) {
+    load();
+}
+
+LirbFile::~LirbFile() {
+    if (m_map) ::munmap(m_map, m_map_size);
+}
+
+void LirbFile::load() {
+    if (m_bytes.size() < HEADER_SIZE || std::memcmp(m_bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("lirb: not a lirb file");
+    }
+    Cursor header(m_bytes, 4, HEADER_SIZE - 4);
+    if (header.u32() != VERSION) throw std::runtime_error("lirb: unsupported version");
+    uint64_t strings_at = header.u64();
+    uint64_t types_at = header.u64();
+    m_module_offset = header.u64();
+    uint64_t index_at = header.u64();
+    if (header.u64() != m_bytes.size()) corrupt("size");
+
+    Cursor strings(m_bytes, strings_at, m_bytes.size() - strings_at);
+    // nstrings + 1 offsets
+    uint32_t nstrings = strings.count(4);
+    std::vector<uint32_t> offsets(static_cast<size_t>(nstrings) + 1);
+    for (auto& off : offsets) off = strings.u32();
+    std::string_view blob = strings.bytes(offsets.back());
+    m_strings.reserve(nstrings);
+    for (uint32_t i = 0; i < nstrings; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > blob.size()) corrupt("string table");
+        m_strings.push_back(blob.substr(offsets[i], offsets[i + 1] - offsets[i]));
+    }
+
+    Cursor types(m_bytes, types_at, m_bytes.size() - types_at);
+    uint32_t ntypes = types.count(1);
+    m_types.reserve(ntypes);
+    Decoder dec(types, m_strings, m_types);
+    for (uint32_t i = 0; i < ntypes; ++i) {
+        auto kind = types.u8();
+        switch (static_cast<TypeKind>(kind)) {
+            case TypeKind::Int: m_types.push_back(std::make_shared<IntType>()); break;
+            case TypeKind::Nil: m_types.push_back(std::make_shared<NilType>()); break;
+            case TypeKind::Struct: m_types.push_back(std::make_shared<StructType>(dec.str())); break;
+            case TypeKind::Array: m_types.push_back(std::make_shared<ArrayType>(dec.type())); break;
+            case TypeKind::Ptr: m_types.push_back(std::make_shared<PtrType>(dec.type())); break;
+            case TypeKind::Fn: {
+                TypePtr ret = dec.type();
+                uint32_t n = types.count(4);
+                std::vector<TypePtr> params;
+                for (uint32_t p = 0; p < n; ++p) params.push_back(dec.type());
+                m_types.push_back(std::make_shared<FnType>(std::move(params), std::move(ret)));
+                break;
+            }
+            case TypeKind::Null: m_types.push_back(nullptr); break;
+            default: corrupt("type kind");
+        }
+    }
+
+    Cursor index(m_bytes, index_at, m_bytes.size() - index_at);
+    uint32_t nfns = index.count(20);
+    m_index.reserve(nfns);
+    for (uint32_t i = 0; i < nfns; ++i) {
+        IndexEntry e;
+        e.name = index.u32();
+        e.offset = index.u64();
+        e.size = index.u64();
+        if (e.name >= m_strings.size()) corrupt("function name");
+        m_index.push_back(e);
+    }
+}
+
+std::optional<size_t> LirbFile::find_function(std::string_view name) const {
+    auto it = std::lower_bound(m_index.begin(), m_index.end(), name, [&](const IndexEntry& e, std::string_view n) {
+        return m_strings[e.name] < n;
+    });
+    if (it == m_index.end() || m_strings[it->name] != name) return std::nullopt;
+    return static_cast<size_t>(it - m_index.begin());
+}
+
+Function LirbFile::read_function(size_t i) const {
+    const IndexEntry& e = m_index.at(i);
+    Cursor in(m_bytes, e.offset, e.size);
+    return Decoder(in, m_strings, m_types).function();
+}
+
+Program LirbFile::read_module() const {
+    Program prog;
+    Cursor in(m_bytes, m_module_offset, m_bytes.size() - m_module_offset);
+    Decoder dec(in, m_strings, m_types);
+    // Name and field count
+    uint32_t nstructs = in.count(8);
+    for (uint32_t i = 0; i < nstructs; ++i) {
+        Struct s;
+        s.name = dec.str();
+        s.fields = dec.typed_names();
+        StructId name = s.name;
+        prog.structs.emplace(std::move(name), std::move(s));
+    }
+    prog.externs = dec.typed_names();
+    prog.funptrs = dec.typed_names();
+    return prog;
+}
+
+Program LirbFile::read_program() const {
+    Program prog = read_module();
+    for (size_t i = 0; i < m_index.size(); ++i) {
+        Function fn = read_function(i);
+        FuncId name = fn.name;
+        prog.functions.emplace_hint(prog.functions.end(), std::move(name), std::move(fn));
+    }
+    return prog;
+}
+
+} // namespace LIR
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "lir.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// "lirb": a compact binary encoding of LIR::Program.
+//
+// All integers are little-endian. Names are indices into a string table and
+// types indices into a type table, so the file stores each of them once.
+//
+//   header    "LIRB", u32 version, u64 offsets of the string table, type
+//             table, module section and function index, u64 file size
+//   strings   u32 n, u32 offsets[n + 1] into the bytes that follow
+//   types     u32 n, then n records (u8 kind, payload); a record only refers
+//             to types before it
+//   module    structs (name, fields), externs and funptrs (name, type)
+//   index     u32 n, then per function (in name order): u32 name, u64 offset,
+//             u64 size of its record
+//   functions name, return type, params, locals, then the blocks with their
+//             instructions (u8 opcode + operands) and terminal
+//
+// LirbFile maps a file and decodes single functions on demand; only the
+// string and type tables are read up front.
+
+namespace LIR {
+
+// --- Writer ---
+
+// Encodes `prog`.
+std::string encode_lirb(const Program& prog);
+
+// --- Reader ---
+
+class LirbFile {
+public:
+    // Maps the file at `path`. Throws std::runtime_error if it cannot be
+    // read or is not a lirb file.
+    explicit LirbFile(const std::string& path);
+    // Reads from the `size` bytes at `data`, which must outlive this object
+    LirbFile(const char* data, size_t size);
+    ~LirbFile();
+    LirbFile(const LirbFile&) = delete;
+    LirbFile& operator=(const LirbFile&) = delete;
+
+    size_t function_count() const { return m_index.size(); }
+    std::string_view function_name(size_t i) const { return m_strings[m_index[i].name]; }
+    // Position of the function called `name`, found by binary search
+    std::optional<size_t> find_function(std::string_view name) const;
+
+    Function read_function(size_t i) const;
+    // Structs, externs and funptrs only
+    Program read_module() const;
+    Program read_program() const;
+
+private:
+    struct IndexEntry {
+        uint32_t name;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    void load();
+
+    std::string_view m_bytes;
+    void* m_map = nullptr;
+    size_t m_map_size = 0;
+    uint64_t m_module_offset = 0;
+    std::vector<std::string_view> m_strings;
+    std::vector<TypePtr> m_types;
+    std::vector<IndexEntry> m_index;
+};
+
+} // namespace LIR
@@ -0,0 +1,129 @@
+#include "lir_dot.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace LIR {
+
+namespace {
+
+// Graphviz's "reds9" color scheme has colors 1 (near white) to 9
+constexpr int SHADES = 9;
+
+// Shade for `value` in [0, max]; execution counts span orders of magnitude,
+// so they are shaded on a log scale
+int shade(uint64_t value, uint64_t max, bool log_scale) {
+    if (max == 0 || value == 0) return 1;
+    double ratio = log_scale ? std::log1p(static_cast<double>(value)) / std::log1p(static_cast<double>(max))
+                             : static_cast<double>(value) / static_cast<double>(max);
+    return 1 + static_cast<int>(std::lround(ratio * (SHADES - 1)));
+}
+
+void put_quoted(std::string& out, const std::string& s) {
+    out += '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += '"';
+}
+
+void put_edge(std::string& out, const BbId& from, const BbId& to, const char* label = nullptr) {
+    out += "  ";
+    put_quoted(out, from);
+    out += " -> ";
+    put_quoted(out, to);
+    if (label) {
+        out += " [label=\"";
+        out += label;
+        out += "\"]";
+    }
+    out += ";\n";
+}
+
+} // namespace
+
+// --- Profiles ---
+
+BlockProfile read_block_profile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("profile: cannot open " + path);
+    BlockProfile profile;
+    std::string line;
+    for (size_t lineno = 1; std::getline(in, line); ++lineno) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        std::istringstream fields(line);
+        std::string fn, label, count_text, extra;
+        if (!(fields >> fn >> label >> count_text) || (fields >> extra)) {
+            throw std::runtime_error("profile: line " + std::to_string(lineno) +
+                                     ": expected 'function label count'");
+        }
+        // from_chars takes no sign, so "-5" cannot wrap to a huge count
+        uint64_t count;
+        const char* end = count_text.data() + count_text.size();
+        auto [ptr, ec] = std::from_chars(count_text.data(), end, count);
+        if (ec != std::errc() || ptr != end) {
+            throw std::runtime_error("profile: line " + std::to_string(lineno) + ": invalid count '" +
+                                     count_text + "'");
+        }
+        profile[fn][label] += count;
+    }
+    return profile;
+}
+
+// --- Rendering ---
+
+void render_dot(const Function& fn, std::string& out, const std::map<BbId, uint64_t>* counts) {
+    auto count_of = [counts](const BbId& label) -> uint64_t {
+        if (!counts) return 0;
+        auto it = counts->find(label);
+        return it == counts->end() ? 0 : it->second;
+    };
+
+    uint64_t max = 0;
+    for (const auto& [label, bb] : fn.body) {
+        max = std::max<uint64_t>(max, counts ? count_of(label) : bb.insts.size());
+    }
+
+    out += "digraph ";
+    put_quoted(out, fn.name);
+    out += " {\n";
+    out += "  node [shape=box, style=filled, colorscheme=reds9, fontname=\"monospace\"];\n";
+    for (const auto& [label, bb] : fn.body) {
+        uint64_t weight = counts ? count_of(label) : bb.insts.size();
+        int color = shade(weight, max, counts != nullptr);
+
+        std::string text = label + "\\n" + std::to_string(bb.insts.size()) +
+                           (bb.insts.size() == 1 ? " inst" : " insts");
+        if (counts) text += "\\n" + std::to_string(weight) + (weight == 1 ? " run" : " runs");
+
+        out += "  ";
+        put_quoted(out, label);
+        out += " [label=\"";
+        out += text;
+        out += "\", fillcolor=";
+        out += std::to_string(color);
+        // Keep the text readable on the darkest shades
+        if (color > SHADES - 3) out += ", fontcolor=white";
+        out += "];\n";
+    }
+
+    for (const auto& [label, bb] : fn.body) {
+        if (auto* j = std::get_if<Jump>(&bb.term)) {
+            put_edge(out, label, j->target);
+        } else if (auto* b = std::get_if<Branch>(&bb.term)) {
+            put_edge(out, label, b->tt, "true");
+            put_edge(out, label, b->ff, "false");
+        } else if (auto* bc = std::get_if<BranchCmp>(&bb.term)) {
+            put_edge(out, label, bc->tt, "true");
+            put_edge(out, label, bc->ff, "false");
+        }
+    }
+    out += "}\n";
+}
+
+} // namespace LIR
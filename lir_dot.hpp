@@ -0,0 +1,35 @@
+#pragma once
+
+#include "lir.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Graphviz export of a function's control-flow graph (see --dot in main.cpp).
+//
+// There is one node per block of Function::body, labelled with the block name
+// and its instruction count, and one edge per terminal target; $branch and
+// $branch_cmp edges are labelled "true" and "false". Nodes are shaded from
+// white to red by instruction count, or by execution count when a profile is
+// given, relative to the largest block of the function.
+
+namespace LIR {
+
+// --- Profiles ---
+
+// Execution counts per block, keyed by function then label
+using BlockProfile = std::map<FuncId, std::map<BbId, uint64_t>>;
+
+// Reads a profile with one "function label count" line per block; blank lines
+// and lines starting with '#' are skipped. Blocks that are not listed ran zero
+// times. Throws std::runtime_error on malformed lines, including counts that
+// are not unsigned decimal numbers.
+BlockProfile read_block_profile(const std::string& path);
+
+// --- Rendering ---
+
+// Appends a `digraph` for `fn`, shaded by `counts` if given
+void render_dot(const Function& fn, std::string& out,
+                const std::map<BbId, uint64_t>* counts = nullptr);
+
+} // namespace LIR
@@ -0,0 +1,381 @@
+#include "lir_emitter.hpp"
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace LIR {
+
+namespace {
+
+void put_int(std::string& out, int n) {
+    char digits[16];
+    auto res = std::to_chars(digits, digits + sizeof(digits), n);
+    out.append(digits, res.ptr);
+}
+
+void put_type(std::string& out, const TypePtr& type);
+
+// "(a, b) -> r", shared by fn types, function pointers and externs
+void put_signature(std::string& out, const FnType& fn) {
+    out += '(';
+    for (size_t i = 0; i < fn.params.size(); ++i) {
+        if (i) out += ", ";
+        put_type(out, fn.params[i]);
+    }
+    out += ") -> ";
+    put_type(out, fn.ret);
+}
+
+// Mirrors the Type::print overrides in lir.hpp
+void put_type(std::string& out, const TypePtr& type) {
+    const Type* t = type.get();
+    if (!t) {
+        out += "<null_type>";
+    } else if (dynamic_cast<const IntType*>(t)) {
+        out += "int";
+    } else if (auto* s = dynamic_cast<const StructType*>(t)) {
+        out += s->id;
+    } else if (auto* p = dynamic_cast<const PtrType*>(t)) {
+        if (auto* fn = dynamic_cast<const FnType*>(p->element.get())) {
+            out += '&';
+            put_signature(out, *fn);
+        } else {
+            out += '&';
+            put_type(out, p->element);
+        }
+    } else if (auto* a = dynamic_cast<const ArrayType*>(t)) {
+        out += '[';
+        put_type(out, a->element);
+        out += ']';
+    } else if (dynamic_cast<const NilType*>(t)) {
+        out += "nil";
+    } else if (auto* fn = dynamic_cast<const FnType*>(t)) {
+        out += "fn ";
+        put_signature(out, *fn);
+    } else {
+        std::ostringstream os;
+        t->print(os);
+        out += os.str();
+    }
+}
+
+// " word": operands and keywords after the first token of a line
+void put_word(std::string& out, std::string_view word) {
+    out += ' ';
+    out += word;
+}
+
+// "lhs = $name"
+void put_def(std::string& out, const VarId& lhs, std::string_view name) {
+    out += lhs;
+    out += " = ";
+    out += name;
+}
+
+void put_inst(std::string& out, const Inst& inst) {
+    out += "  ";
+    std::visit([&out](const auto& arg) {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, Const>) {
+            put_def(out, arg.lhs, "$const ");
+            put_int(out, arg.val);
+        } else if constexpr (std::is_same_v<T, Copy>) {
+            put_def(out, arg.lhs, "$copy");
+            put_word(out, arg.op);
+        } else if constexpr (std::is_same_v<T, Arith>) {
+            put_def(out, arg.lhs, "$arith");
+            put_word(out, arith_name(arg.aop));
+            put_word(out, arg.left);
+            put_word(out, arg.right);
+        } else if constexpr (std::is_same_v<T, Cmp>) {
+            put_def(out, arg.lhs, "$cmp");
+            put_word(out, rel_name(arg.rop));
+            put_word(out, arg.left);
+            put_word(out, arg.right);
+        } else if constexpr (std::is_same_v<T, Load>) {
+            put_def(out, arg.lhs, "$load");
+            put_word(out, arg.src);
+        } else if constexpr (std::is_same_v<T, Store>) {
+            out += "$store";
+            put_word(out, arg.dst);
+            put_word(out, arg.op);
+        } else if constexpr (std::is_same_v<T, Gfp>) {
+            put_def(out, arg.lhs, "$gfp");
+            put_word(out, arg.src);
+            put_word(out, arg.sid);
+            out += "::";
+            out += arg.field;
+        } else if constexpr (std::is_same_v<T, Gep>) {
+            put_def(out, arg.lhs, "$gep");
+            put_word(out, arg.src);
+            put_word(out, arg.idx);
+            put_word(out, arg.checked ? "[true]" : "[false]");
+        } else if constexpr (std::is_same_v<T, AllocSingle>) {
+            put_def(out, arg.lhs, "$alloc_single ");
+            put_type(out, arg.typ);
+        } else if constexpr (std::is_same_v<T, AllocArray>) {
+            put_def(out, arg.lhs, "$alloc_array");
+            put_word(out, arg.amt);
+            out += ' ';
+            put_type(out, arg.typ);
+        } else if constexpr (std::is_same_v<T, Call>) {
+            if (arg.lhs) put_def(out, *arg.lhs, "$call ");
+            else out += "$call ";
+            out += arg.callee;
+            out += '(';
+            // Args are stored in reverse order
+            for (size_t i = arg.args.size(); i-- > 0; ) {
+                out += arg.args[i];
+                if (i > 0) out += ", ";
+            }
+            out += ')';
+        } else if constexpr (std::is_same_v<T, Select>) {
+            put_def(out, arg.lhs, "$select");
+            put_word(out, arg.guard);
+            put_word(out, arg.tt);
+            put_word(out, arg.ff);
+        }
+    }, inst);
+    out += '\n';
+}
+
+void put_terminal(std::string& out, const Terminal& term) {
+    out += "  ";
+    std::visit([&out](const auto& arg) {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, Jump>) {
+            out += "$jump";
+            put_word(out, arg.target);
+        } else if constexpr (std::is_same_v<T, Branch>) {
+            out += "$branch";
+            put_word(out, arg.guard);
+            put_word(out, arg.tt);
+            put_word(out, arg.ff);
+        } else if constexpr (std::is_same_v<T, Ret>) {
+            out += "$ret";
+            if (arg.val) put_word(out, *arg.val);
+        } else if constexpr (std::is_same_v<T, BranchCmp>) {
+            out += "$branch_cmp";
+            put_word(out, rel_name(arg.rop));
+            put_word(out, arg.left);
+            put_word(out, arg.right);
+            put_word(out, arg.tt);
+            put_word(out, arg.ff);
+        } else if constexpr (std::is_same_v<T, std::monostate>) {
+            out += "$unreachable";
+        }
+    }, term);
+    out += '\n';
+}
+
+// Parameters are listed in the signature, not in `let`. Functions rarely
+// have more than a handful, so a linear scan beats building a set.
+bool is_param(const Function& fn, const VarId& v) {
+    for (const auto& [pname, ptype] : fn.params) {
+        if (pname == v) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// --- Rendering ---
+
+void render_header(const Program& prog, std::string& out) {
+    for (const auto& [name, type] : prog.funptrs) {
+        out += "funptr ";
+        out += name;
+        out += ": ";
+        put_type(out, type);
+        out += '\n';
+    }
+    if (!prog.funptrs.empty()) out += '\n';
+
+    for (const auto& [name, s] : prog.structs) {
+        out += "struct ";
+        out += name;
+        out += " {\n";
+        for (const auto& [fname, ftype] : s.fields) {
+            out += "  ";
+            out += fname;
+            out += ": ";
+            put_type(out, ftype);
+            out += '\n';
+        }
+        out += "}\n\n";
+    }
+
+    for (const auto& [name, type] : prog.externs) {
+        out += "extern ";
+        out += name;
+        out += ": ";
+        // Externs print their signature without the `fn` keyword
+        if (auto* fn = dynamic_cast<const FnType*>(type.get())) put_signature(out, *fn);
+        else put_type(out, type);
+        out += '\n';
+    }
+    if (!prog.externs.empty()) out += '\n';
+}
+
+void render_function(const Function& fn, std::string& out) {
+    out += "fn ";
+    out += fn.name;
+    out += '(';
+    for (size_t i = 0; i < fn.params.size(); ++i) {
+        if (i) out += ", ";
+        out += fn.params[i].first;
+        out += ':';
+        put_type(out, fn.params[i].second);
+    }
+    out += ") -> ";
+    put_type(out, fn.rettyp);
+    out += " {\n";
+
+    bool first = true;
+    for (const auto& [local, type] : fn.locals) {
+        if (is_param(fn, local)) continue;
+        out += first ? "let " : ", ";
+        first = false;
+        out += local;
+        out += ':';
+        put_type(out, type);
+    }
+    if (!first) out += '\n';
+
+    // Labels in lexicographic order, which is the order of the body map
+    for (const auto& [label, bb] : fn.body) {
+        out += '\n';
+        out += label;
+        out += ":\n";
+        for (const auto& inst : bb.insts) put_inst(out, inst);
+        put_terminal(out, bb.term);
+    }
+    out += "}\n\n";
+}
+
+// --- Output ---
+
+void write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+LirEmitter::LirEmitter(int fd, size_t flush_bytes)
+    : m_fd(fd), m_flush_bytes(flush_bytes) {
+    // Functions are appended whole, so leave room for one past the threshold
+    m_buffer.reserve(flush_bytes + flush_bytes / 4);
+}
+
+LirEmitter::LirEmitter(std::string& sink, size_t flush_bytes) : LirEmitter(-1, flush_bytes) {
+    m_sink = &sink;
+}
+
+LirEmitter::~LirEmitter() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // Nowhere to report it; callers that care flush() explicitly
+    }
+}
+
+void LirEmitter::emit(const Program& prog) {
+    emit_header(prog);
+    for (const auto& [name, fn] : prog.functions) emit_function(fn);
+}
+
+void LirEmitter::emit_header(const Program& prog) {
+    render_header(prog, m_buffer);
+    maybe_flush();
+}
+
+void LirEmitter::emit_function(const Function& fn) {
+    render_function(fn, m_buffer);
+    maybe_flush();
+}
+
+void LirEmitter::emit(const Program& prog, ThreadPool& pool) {
+    if (pool.size() == 1 || prog.functions.size() < 2) {
+        emit(prog);
+        return;
+    }
+    emit_header(prog);
+
+    std::vector<const Function*> fns;
+    fns.reserve(prog.functions.size());
+    for (const auto& [name, fn] : prog.functions) fns.push_back(&fn);
+
+    // Whoever finishes a function tries to become the writer and appends
+    // every leading function that is ready; a worker that loses the race
+    // leaves its buffer to the current writer, which rechecks before leaving.
+    // Both can miss each other's store (and try_lock may fail spuriously), so
+    // the drain after parallel_for() appends whatever is left.
+    std::vector<std::string> texts(fns.size());
+    std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[fns.size()]);
+    for (size_t i = 0; i < fns.size(); ++i) ready[i].store(false, std::memory_order_relaxed);
+    std::atomic<size_t> next{0};
+    std::mutex writer;
+    auto drain = [&] {
+        while (true) {
+            std::unique_lock<std::mutex> lock(writer, std::try_to_lock);
+            if (!lock.owns_lock()) return;
+            size_t i = next.load(std::memory_order_relaxed);
+            for (; i < fns.size() && ready[i].load(std::memory_order_acquire); ++i) {
+                append(texts[i]);
+                std::string().swap(texts[i]);
+            }
+            next.store(i, std::memory_order_release);
+            lock.unlock();
+            if (i == fns.size() || !ready[i].load(std::memory_order_acquire)) return;
+        }
+    };
+    pool.parallel_for(fns.size(), [&](size_t i, size_t) {
+        render_function(*fns[i], texts[i]);
+        ready[i].store(true, std::memory_order_release);
+        drain();
+    });
+
+    // Every function is rendered once parallel_for() returns
+    std::lock_guard<std::mutex> lock(writer);
+    for (size_t i = next.load(std::memory_order_relaxed); i < fns.size(); ++i) append(texts[i]);
+}
+
+void LirEmitter::append(std::string_view text) {
+    m_buffer += text;
+    maybe_flush();
+}
+
+void LirEmitter::flush() {
+    if (m_buffer.empty()) return;
+    if (m_sink) {
+        m_sink->append(m_buffer);
+        m_buffer.clear();
+        return;
+    }
+    try {
+        write_all(m_fd, m_buffer);
+    } catch (...) {
+        m_buffer.clear(); // not retried by the destructor
+        throw;
+    }
+    m_buffer.clear();
+}
+
+void LirEmitter::retarget(int fd) {
+    flush();
+    m_fd = fd;
+    m_sink = nullptr;
+}
+
+} // namespace LIR
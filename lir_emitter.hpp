@@ -0,0 +1,68 @@
+#pragma once
+
+#include "lir.hpp"
+#include "thread_pool.hpp"
+#include <string>
+#include <string_view>
+
+// Fast LIR text output. Produces exactly the text of operator<<(ostream&,
+// const Program&) in lir.hpp, but appends into a contiguous buffer (integers
+// via std::to_chars, no iostream state or locale) and hands it to the
+// operating system in large write() calls.
+
+namespace LIR {
+
+// --- Rendering ---
+
+// Appends the funptrs, structs and externs that precede the functions.
+void render_header(const Program& prog, std::string& out);
+// Appends one function, including the blank line after it.
+void render_function(const Function& fn, std::string& out);
+
+// --- Output ---
+
+// Buffers rendered text and writes it to a file descriptor (or appends it to
+// a string) once more than `flush_bytes` have accumulated. Write errors throw
+// std::runtime_error.
+class LirEmitter {
+public:
+    static constexpr size_t DEFAULT_FLUSH_BYTES = 1 << 20;
+
+    explicit LirEmitter(int fd, size_t flush_bytes = DEFAULT_FLUSH_BYTES);
+    // Flushes into `sink`, which must outlive the emitter
+    explicit LirEmitter(std::string& sink, size_t flush_bytes = DEFAULT_FLUSH_BYTES);
+    // Flushes what is left; errors are only reported by an explicit flush()
+    ~LirEmitter();
+    LirEmitter(const LirEmitter&) = delete;
+    LirEmitter& operator=(const LirEmitter&) = delete;
+
+    void emit(const Program& prog);
+    // The pieces of emit(prog), for callers producing functions one by one
+    void emit_header(const Program& prog);
+    void emit_function(const Function& fn);
+    // Renders the functions on `pool`, each into its own buffer, and writes
+    // them in order as soon as every function before them is done
+    void emit(const Program& prog, ThreadPool& pool);
+    // Appends already rendered text
+    void append(std::string_view text);
+
+    void flush();
+    // Flushes, then writes to `fd` from now on (not to a sink), keeping the
+    // buffer's memory
+    void retarget(int fd);
+    // Drops the text not written yet
+    void discard() { m_buffer.clear(); }
+
+private:
+    void maybe_flush() { if (m_buffer.size() >= m_flush_bytes) flush(); }
+
+    int m_fd;
+    std::string* m_sink = nullptr;
+    size_t m_flush_bytes;
+    std::string m_buffer;
+};
+
+// Writes all of `data` to `fd`, retrying short and interrupted writes.
+void write_all(int fd, std::string_view data);
+
+} // namespace LIR
@@ -0,0 +1,310 @@
+#include "lir_json.hpp"
+#include <charconv>
+
+namespace LIR {
+
+namespace {
+
+class JsonWriter {
+public:
+    explicit JsonWriter(LirEmitter& out) : m_out(out) {}
+
+    void write(const Program& prog) {
+        m_buf += "{\"structs\": [";
+        bool first = true;
+        for (const auto& [name, s] : prog.structs) {
+            item(first);
+            m_buf += "{\"name\": ";
+            quoted(name);
+            m_buf += ", \"fields\": ";
+            bindings(s.fields);
+            m_buf += '}';
+            ship();
+        }
+        m_buf += "],\n\"externs\": ";
+        bindings(prog.externs, true);
+        m_buf += ",\n\"funptrs\": ";
+        bindings(prog.funptrs, true);
+        m_buf += ",\n\"functions\": [";
+        first = true;
+        for (const auto& [name, fn] : prog.functions) {
+            item(first);
+            function(fn);
+        }
+        m_buf += "]}\n";
+        ship();
+    }
+
+private:
+    // Hands the text written so far to the emitter
+    void ship() {
+        m_out.append(m_buf);
+        m_buf.clear();
+    }
+
+    // Separator before an array element, each on its own line
+    void item(bool& first) {
+        m_buf += first ? "\n" : ",\n";
+        first = false;
+    }
+
+    void quoted(std::string_view s) {
+        m_buf += '"';
+        for (char c : s) {
+            switch (c) {
+                case '"':  m_buf += "\\\""; break;
+                case '\\': m_buf += "\\\\"; break;
+                case '\n': m_buf += "\\n"; break;
+                case '\t': m_buf += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static const char hex[] = "0123456789abcdef";
+                        m_buf += "\\u00";
+                        m_buf += hex[(c >> 4) & 0xf];
+                        m_buf += hex[c & 0xf];
+                    } else {
+                        m_buf += c;
+                    }
+            }
+        }
+        m_buf += '"';
+    }
+
+    void number(int n) {
+        char digits[16];
+        auto res = std::to_chars(digits, digits + sizeof(digits), n);
+        m_buf.append(digits, res.ptr);
+    }
+
+    // `, "key": ` before every field but the kind
+    void key(const char* k) {
+        m_buf += ", \"";
+        m_buf += k;
+        m_buf += "\": ";
+    }
+    void field(const char* k, std::string_view v) {
+        key(k);
+        quoted(v);
+    }
+    void optional_field(const char* k, const std::optional<std::string>& v) {
+        key(k);
+        if (v) quoted(*v);
+        else m_buf += "null";
+    }
+    void kind(const char* k) {
+        m_buf += "{\"kind\": \"";
+        m_buf += k;
+        m_buf += '"';
+    }
+
+    void type(const TypePtr& t) {
+        const Type* p = t.get();
+        if (!p) {
+            m_buf += "null";
+        } else if (dynamic_cast<const IntType*>(p)) {
+            kind("IntType");
+            m_buf += '}';
+        } else if (dynamic_cast<const NilType*>(p)) {
+            kind("NilType");
+            m_buf += '}';
+        } else if (auto* s = dynamic_cast<const StructType*>(p)) {
+            kind("StructType");
+            field("id", s->id);
+            m_buf += '}';
+        } else if (auto* a = dynamic_cast<const ArrayType*>(p)) {
+            kind("ArrayType");
+            key("element");
+            type(a->element);
+            m_buf += '}';
+        } else if (auto* ptr = dynamic_cast<const PtrType*>(p)) {
+            kind("PtrType");
+            key("element");
+            type(ptr->element);
+            m_buf += '}';
+        } else if (auto* fn = dynamic_cast<const FnType*>(p)) {
+            kind("FnType");
+            key("params");
+            m_buf += '[';
+            for (size_t i = 0; i < fn->params.size(); ++i) {
+                if (i) m_buf += ", ";
+                type(fn->params[i]);
+            }
+            m_buf += ']';
+            key("ret");
+            type(fn->ret);
+            m_buf += '}';
+        } else {
+            m_buf += "null";
+        }
+    }
+
+    // [{"name", "type"}] from a name -> type map or list; `lines` puts each
+    // entry on its own line and ships it
+    template <typename Bindings>
+    void bindings(const Bindings& list, bool lines = false) {
+        m_buf += '[';
+        bool first = true;
+        for (const auto& [name, t] : list) {
+            if (lines) item(first);
+            else if (!first) m_buf += ", ";
+            first = false;
+            m_buf += "{\"name\": ";
+            quoted(name);
+            key("type");
+            type(t);
+            m_buf += '}';
+            if (lines) ship();
+        }
+        m_buf += ']';
+    }
+
+    void function(const Function& fn) {
+        m_buf += "{\"name\": ";
+        quoted(fn.name);
+        key("params");
+        bindings(fn.params);
+        key("rettyp");
+        type(fn.rettyp);
+        key("locals");
+        bindings(fn.locals);
+        key("body");
+        m_buf += '[';
+        bool first = true;
+        for (const auto& [label, bb] : fn.body) {
+            if (!first) m_buf += ',';
+            first = false;
+            m_buf += "\n {\"label\": ";
+            quoted(label);
+            key("insts");
+            m_buf += '[';
+            for (size_t i = 0; i < bb.insts.size(); ++i) {
+                m_buf += i ? ",\n  " : "\n  ";
+                inst(bb.insts[i]);
+            }
+            m_buf += ']';
+            key("term");
+            terminal(bb.term);
+            m_buf += '}';
+            ship();
+        }
+        m_buf += "]}";
+        ship();
+    }
+
+    void inst(const Inst& inst) {
+        std::visit([this](const auto& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, Const>) {
+                kind("Const");
+                field("lhs", arg.lhs);
+                key("val");
+                number(arg.val);
+            } else if constexpr (std::is_same_v<T, Copy>) {
+                kind("Copy");
+                field("lhs", arg.lhs);
+                field("op", arg.op);
+            } else if constexpr (std::is_same_v<T, Arith>) {
+                kind("Arith");
+                field("lhs", arg.lhs);
+                field("aop", arith_name(arg.aop));
+                field("left", arg.left);
+                field("right", arg.right);
+            } else if constexpr (std::is_same_v<T, Cmp>) {
+                kind("Cmp");
+                field("lhs", arg.lhs);
+                field("rop", rel_name(arg.rop));
+                field("left", arg.left);
+                field("right", arg.right);
+            } else if constexpr (std::is_same_v<T, Load>) {
+                kind("Load");
+                field("lhs", arg.lhs);
+                field("src", arg.src);
+            } else if constexpr (std::is_same_v<T, Store>) {
+                kind("Store");
+                field("dst", arg.dst);
+                field("op", arg.op);
+            } else if constexpr (std::is_same_v<T, Gfp>) {
+                kind("Gfp");
+                field("lhs", arg.lhs);
+                field("src", arg.src);
+                field("sid", arg.sid);
+                field("field", arg.field);
+            } else if constexpr (std::is_same_v<T, Gep>) {
+                kind("Gep");
+                field("lhs", arg.lhs);
+                field("src", arg.src);
+                field("idx", arg.idx);
+                key("checked");
+                m_buf += arg.checked ? "true" : "false";
+            } else if constexpr (std::is_same_v<T, AllocSingle>) {
+                kind("AllocSingle");
+                field("lhs", arg.lhs);
+                key("typ");
+                type(arg.typ);
+            } else if constexpr (std::is_same_v<T, AllocArray>) {
+                kind("AllocArray");
+                field("lhs", arg.lhs);
+                field("amt", arg.amt);
+                key("typ");
+                type(arg.typ);
+            } else if constexpr (std::is_same_v<T, Call>) {
+                kind("Call");
+                optional_field("lhs", arg.lhs);
+                field("callee", arg.callee);
+                key("args");
+                m_buf += '[';
+                for (size_t i = arg.args.size(); i-- > 0; ) {
+                    quoted(arg.args[i]);
+                    if (i > 0) m_buf += ", ";
+                }
+                m_buf += ']';
+            } else if constexpr (std::is_same_v<T, Select>) {
+                kind("Select");
+                field("lhs", arg.lhs);
+                field("guard", arg.guard);
+                field("tt", arg.tt);
+                field("ff", arg.ff);
+            }
+        }, inst);
+        m_buf += '}';
+    }
+
+    void terminal(const Terminal& term) {
+        std::visit([this](const auto& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, Jump>) {
+                kind("Jump");
+                field("target", arg.target);
+            } else if constexpr (std::is_same_v<T, Branch>) {
+                kind("Branch");
+                field("guard", arg.guard);
+                field("tt", arg.tt);
+                field("ff", arg.ff);
+            } else if constexpr (std::is_same_v<T, Ret>) {
+                kind("Ret");
+                optional_field("val", arg.val);
+            } else if constexpr (std::is_same_v<T, BranchCmp>) {
+                kind("BranchCmp");
+                field("rop", rel_name(arg.rop));
+                field("left", arg.left);
+                field("right", arg.right);
+                field("tt", arg.tt);
+                field("ff", arg.ff);
+            } else if constexpr (std::is_same_v<T, std::monostate>) {
+                kind("Unreachable");
+            }
+        }, term);
+        m_buf += '}';
+    }
+
+    LirEmitter& m_out;
+    std::string m_buf;
+};
+
+} // namespace
+
+void emit_json(const Program& prog, LirEmitter& out) {
+    JsonWriter(out).write(prog);
+}
+
+} // namespace LIR
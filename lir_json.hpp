@@ -0,0 +1,31 @@
+#pragma once
+
+#include "lir.hpp"
+#include "lir_emitter.hpp"
+
+// JSON export of LIR::Program, written straight into a LirEmitter while the
+// program is walked, so no document is built and the extra memory is one
+// basic block's worth of text plus the emitter's buffer.
+//
+// The schema mirrors lir.hpp: objects have the field names of the structs
+// there, and every type, instruction and terminal carries a "kind" naming its
+// struct.
+//
+//   {"structs": [{"name", "fields": [{"name", "type"}]}],
+//    "externs": [{"name", "type"}], "funptrs": [{"name", "type"}],
+//    "functions": [{"name", "params": [{"name", "type"}], "rettyp",
+//                   "locals": [{"name", "type"}],
+//                   "body": [{"label", "insts": [...], "term"}]}]}
+//
+// Types are {"kind": "IntType" | "NilType"}, {"kind": "StructType", "id"},
+// {"kind": "ArrayType" | "PtrType", "element"} or {"kind": "FnType",
+// "params", "ret"}. Collections keep the order of their maps; "locals"
+// includes the parameters, as Function::locals does. Call "args" are listed
+// in call order (the vector in Call stores them reversed), a missing Call lhs
+// or Ret val is null, and an unset terminal is {"kind": "Unreachable"}.
+
+namespace LIR {
+
+void emit_json(const Program& prog, LirEmitter& out);
+
+} // namespace LIR
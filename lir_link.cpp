@@ -0,0 +1,93 @@
+#include "lir_link.hpp"
+#include <sstream>
+#include <stdexcept>
+
+namespace LIR {
+
+namespace {
+
+std::string type_text(const TypePtr& type) {
+    std::ostringstream os;
+    os << type;
+    return os.str();
+}
+
+bool same_struct(const Struct& a, const Struct& b) {
+    if (a.fields.size() != b.fields.size()) return false;
+    for (auto ia = a.fields.begin(), ib = b.fields.begin(); ia != a.fields.end(); ++ia, ++ib) {
+        if (ia->first != ib->first || type_text(ia->second) != type_text(ib->second)) return false;
+    }
+    return true;
+}
+
+TypePtr signature_of(const Function& fn) {
+    std::vector<TypePtr> params;
+    for (const auto& [name, type] : fn.params) params.push_back(type);
+    return std::make_shared<FnType>(std::move(params), fn.rettyp);
+}
+
+} // namespace
+
+Program link(std::vector<Program> modules, const std::vector<std::string>& names) {
+    Program out;
+    // The module each definition came from, for error messages
+    std::map<std::string, size_t> struct_from, function_from, extern_from;
+
+    for (size_t m = 0; m < modules.size(); ++m) {
+        Program& mod = modules[m];
+        for (auto& [id, s] : mod.structs) {
+            // try_emplace leaves `s` alone if the name is taken
+            auto [it, inserted] = out.structs.try_emplace(id, std::move(s));
+            if (inserted) {
+                struct_from[id] = m;
+            } else if (!same_struct(it->second, s)) {
+                throw std::runtime_error("link: struct " + id + " differs between " + names[struct_from[id]] +
+                                         " and " + names[m]);
+            }
+        }
+        for (auto& [name, fn] : mod.functions) {
+            auto [it, inserted] = out.functions.try_emplace(name, std::move(fn));
+            if (!inserted) {
+                throw std::runtime_error("link: function " + name + " is defined in both " +
+                                         names[function_from[name]] + " and " + names[m]);
+            }
+            function_from[name] = m;
+        }
+        for (auto& [name, type] : mod.funptrs) out.funptrs.emplace(name, std::move(type));
+        for (auto& [name, type] : mod.externs) {
+            auto [it, inserted] = out.externs.emplace(name, type);
+            if (inserted) {
+                extern_from[name] = m;
+            } else if (type_text(it->second) != type_text(type)) {
+                throw std::runtime_error("link: extern " + name + " has different types in " +
+                                         names[extern_from[name]] + " and " + names[m]);
+            }
+        }
+    }
+
+    // Externs defined by a module become calls of that function
+    for (auto it = out.externs.begin(); it != out.externs.end();) {
+        auto fn = out.functions.find(it->first);
+        if (fn == out.functions.end()) {
+            ++it;
+            continue;
+        }
+        // Programs give main no funptr (see lower.md), so nothing can call it
+        if (it->first == "main") {
+            throw std::runtime_error("link: extern main in " + names[extern_from[it->first]] + " cannot refer to " +
+                                     names[function_from[it->first]] + "'s main");
+        }
+        TypePtr signature = signature_of(fn->second);
+        if (type_text(signature) != type_text(it->second)) {
+            throw std::runtime_error("link: extern " + it->first + " in " + names[extern_from[it->first]] + " is " +
+                                     type_text(it->second) + " but " + names[function_from[it->first]] +
+                                     " defines it as " + type_text(signature));
+        }
+        // Callers reach the definition through its funptr, as within a module
+        out.funptrs.emplace(it->first, std::make_shared<PtrType>(signature));
+        it = out.externs.erase(it);
+    }
+    return out;
+}
+
+} // namespace LIR
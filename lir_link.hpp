@@ -0,0 +1,25 @@
+#pragma once
+
+#include "lir.hpp"
+#include <string>
+#include <vector>
+
+// Links separately lowered modules into one LIR::Program (see `lower a.astj
+// b.astj ...` in main.cpp). Modules share structs and call each other's
+// functions through externs:
+//   - structs of the same name must have the same fields and are kept once
+//   - a function may be defined by one module only
+//   - externs of the same name must have the same type; an extern that a
+//     module defines becomes that function's funptrs entry, so calls to it
+//     are ordinary calls of a function of the program; main has no funptrs
+//     entry, so an extern main is an error
+// Types are compared exactly (as printed), so nil does not stand in for a
+// pointer the way it does in Type::equals.
+
+namespace LIR {
+
+// Merges `modules`, named by `names` in error messages. Throws
+// std::runtime_error naming the modules that disagree.
+Program link(std::vector<Program> modules, const std::vector<std::string>& names);
+
+} // namespace LIR
@@ -0,0 +1,478 @@
+#include "lir_passes.hpp"
+#include "dataflow.hpp"
+#include "def_use.hpp"
+#include "lir_utils.hpp"
+#include <algorithm>
+#include <set>
+#include <string_view>
+#include <unordered_set>
+
+namespace LIR {
+
+// --- Shared Helpers ---
+
+bool remove_unreachable_blocks(Function& fn) {
+    // Find all reachable blocks starting from entry block
+    std::set<BbId> reachable;
+    std::vector<BbId> worklist;
+    worklist.push_back("entry");
+    reachable.insert("entry");
+
+    while (!worklist.empty()) {
+        BbId current = worklist.back();
+        worklist.pop_back();
+
+        auto it = fn.body.find(current);
+        if (it == fn.body.end()) {
+            continue;
+        }
+        for (const auto& succ : successors(it->second.term)) {
+            if (reachable.insert(succ).second) {
+                worklist.push_back(succ);
+            }
+        }
+    }
+
+    // Remove unreachable blocks
+    bool changed = false;
+    for (auto it = fn.body.begin(); it != fn.body.end(); ) {
+        if (reachable.find(it->first) == reachable.end()) {
+            it = fn.body.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    return changed;
+}
+
+namespace {
+
+// True if `inst` can be deleted when its result is unused: it has no side
+// effects and cannot trap.
+bool is_removable(const Inst& inst, const std::map<VarId, int>& constants) {
+    if (auto* arith = std::get_if<Arith>(&inst)) {
+        // Add, sub and mul wrap (see InstInfo::can_trap)
+        if (arith->aop != ArithOp::Div) return true;
+        // Division traps on zero (and overflows on INT_MIN / -1)
+        auto it = constants.find(arith->right);
+        return it != constants.end() && it->second != 0 && it->second != -1;
+    }
+    const InstInfo& info = inst_info(inst);
+    return !info.side_effects && !info.can_trap;
+}
+
+bool is_temporary(const VarId& name) {
+    return name.rfind("_tmp", 0) == 0 || name.rfind("_inner", 0) == 0 ||
+           name.rfind("_const_", 0) == 0;
+}
+
+// --- Function Passes ---
+
+class UnreachableBlocksPass : public FunctionPass {
+public:
+    const char* name() const override { return "unreachable-blocks"; }
+    bool run(Function& fn, PassContext& ctx) override {
+        // The cached RPO only visits reachable blocks
+        const auto& cfg = ctx.am.get<CFGInfo>(fn);
+        if (cfg.rpo.size() == fn.body.size()) return false;
+        return remove_unreachable_blocks(fn);
+    }
+};
+
+class ConstFoldPass : public FunctionPass {
+public:
+    const char* name() const override { return "const-fold"; }
+    bool run(Function& fn, PassContext&) override {
+        auto constants = constant_values(fn);
+        auto value_of = [&](const VarId& v) -> std::optional<int> {
+            auto it = constants.find(v);
+            if (it == constants.end()) return std::nullopt;
+            return it->second;
+        };
+
+        // Collect the folded values first: creating constants inserts into the
+        // entry block, which would invalidate positions while we iterate.
+        struct Fold { Inst* inst; VarId lhs; int value; };
+        std::vector<Fold> folds;
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            for (auto& inst : bb.insts) {
+                if (auto* arith = std::get_if<Arith>(&inst)) {
+                    auto l = value_of(arith->left), r = value_of(arith->right);
+                    if (!l || !r) continue;
+                    if (auto v = fold_arith(arith->aop, *l, *r)) {
+                        folds.push_back({&inst, arith->lhs, *v});
+                    }
+                } else if (auto* cmp = std::get_if<Cmp>(&inst)) {
+                    auto l = value_of(cmp->left), r = value_of(cmp->right);
+                    if (!l || !r) continue;
+                    folds.push_back({&inst, cmp->lhs, fold_cmp(cmp->rop, *l, *r)});
+                } else if (auto* sel = std::get_if<Select>(&inst)) {
+                    if (auto g = value_of(sel->guard)) {
+                        inst = Copy{sel->lhs, *g != 0 ? sel->tt : sel->ff};
+                        changed = true;
+                    }
+                }
+            }
+            if (auto* branch = std::get_if<Branch>(&bb.term)) {
+                if (auto g = value_of(branch->guard)) {
+                    bb.term = Jump{*g != 0 ? branch->tt : branch->ff};
+                    changed = true;
+                }
+            } else if (auto* bc = std::get_if<BranchCmp>(&bb.term)) {
+                auto l = value_of(bc->left), r = value_of(bc->right);
+                if (l && r) {
+                    bb.term = Jump{fold_cmp(bc->rop, *l, *r) ? bc->tt : bc->ff};
+                    changed = true;
+                }
+            }
+        }
+
+        for (auto& fold : folds) {
+            *fold.inst = Copy{fold.lhs, const_name(fold.value)};
+        }
+        for (auto& fold : folds) {
+            ensure_const(fn, fold.value);
+        }
+        return changed || !folds.empty();
+    }
+};
+
+class CopyPropPass : public FunctionPass {
+public:
+    const char* name() const override { return "copy-prop"; }
+    bool preserves_cfg() const override { return true; }
+    bool run(Function& fn, PassContext&) override {
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            // avail[x] = y while `x = $copy y` still holds
+            std::map<VarId, VarId> avail;
+            auto rewrite = [&](VarId& use) {
+                auto it = avail.find(use);
+                if (it != avail.end()) {
+                    use = it->second;
+                    changed = true;
+                }
+            };
+            std::vector<Inst> out;
+            out.reserve(bb.insts.size());
+            for (auto& inst : bb.insts) {
+                for_each_use(inst, rewrite);
+                if (auto* copy = std::get_if<Copy>(&inst)) {
+                    if (copy->lhs == copy->op) { changed = true; continue; }
+                }
+                if (const VarId* def = inst_def(inst)) {
+                    avail.erase(*def);
+                    for (auto it = avail.begin(); it != avail.end(); ) {
+                        if (it->second == *def) it = avail.erase(it); else ++it;
+                    }
+                    if (auto* copy = std::get_if<Copy>(&inst)) {
+                        avail[copy->lhs] = copy->op;
+                    }
+                }
+                out.push_back(std::move(inst));
+            }
+            for_each_term_use(bb.term, rewrite);
+            bb.insts = std::move(out);
+        }
+        return propagate_invariant_copies(fn) || changed;
+    }
+
+private:
+    // Across blocks: if `x = $copy y` is the only definition of x, x is
+    // never read before it (not live into entry) and y never changes (an
+    // unassigned parameter, a constant or a global), every read of x can
+    // read y instead.
+    static bool propagate_invariant_copies(Function& fn) {
+        auto constants = constant_values(fn);
+        Liveness live = Liveness::compute(fn);
+        if (!live.sets.reached("entry")) return false;
+        const DenseBitSet& live_at_entry = live.sets.in_of("entry");
+        std::set<VarId> params;
+        for (const auto& [name, typ] : fn.params) params.insert(name);
+
+        DefUseIndex du(fn);
+        auto invariant = [&](const VarId& v) {
+            if (!fn.locals.count(v)) return true;
+            if (constants.count(v)) return true;
+            return params.count(v) && du.defs(v).empty();
+        };
+
+        // Snapshot the candidates (single-definition copies) before rewriting
+        std::vector<DefUseIndex::NodeId> copies;
+        for (auto& [label, bb] : fn.body) {
+            for (const auto& inst : bb.insts) {
+                auto* copy = std::get_if<Copy>(&inst);
+                if (!copy || params.count(copy->lhs)) continue;
+                const auto& defs = du.defs(copy->lhs);
+                if (defs.size() == 1) copies.push_back(defs.front());
+            }
+        }
+        bool changed = false;
+        for (auto n : copies) {
+            auto copy = std::get<Copy>(du.inst(n));
+            if (!invariant(copy.op) || live_at_entry.test(live.vars.id(copy.lhs))) continue;
+            du.replace_all_uses(copy.lhs, copy.op);
+            du.erase(n);
+            changed = true;
+        }
+        du.compact();
+        return changed;
+    }
+};
+
+class JumpThreadingPass : public FunctionPass {
+public:
+    const char* name() const override { return "jump-threading"; }
+    bool run(Function& fn, PassContext&) override {
+        // forward[B] = X for every non-entry block B that is just `$jump X`
+        std::map<BbId, BbId> forward;
+        for (const auto& [label, bb] : fn.body) {
+            auto* jump = std::get_if<Jump>(&bb.term);
+            if (label != "entry" && bb.insts.empty() && jump && jump->target != label) {
+                forward[label] = jump->target;
+            }
+        }
+        // Follow chains of forwarding blocks (stopping at cycles)
+        auto resolve = [&](const BbId& start) {
+            BbId cur = start;
+            for (size_t steps = 0; steps <= forward.size(); ++steps) {
+                auto it = forward.find(cur);
+                if (it == forward.end()) return cur;
+                cur = it->second;
+            }
+            return start;
+        };
+
+        bool changed = false;
+        auto retarget = [&](BbId& target) {
+            BbId final_target = resolve(target);
+            if (final_target != target) {
+                target = final_target;
+                changed = true;
+            }
+        };
+        for (auto& [label, bb] : fn.body) {
+            if (auto* jump = std::get_if<Jump>(&bb.term)) {
+                retarget(jump->target);
+            } else if (auto* branch = std::get_if<Branch>(&bb.term)) {
+                retarget(branch->tt);
+                retarget(branch->ff);
+                if (branch->tt == branch->ff) {
+                    bb.term = Jump{branch->tt};
+                    changed = true;
+                }
+            } else if (auto* bc = std::get_if<BranchCmp>(&bb.term)) {
+                retarget(bc->tt);
+                retarget(bc->ff);
+                if (bc->tt == bc->ff) {
+                    bb.term = Jump{bc->tt};
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+class MergeBlocksPass : public FunctionPass {
+public:
+    const char* name() const override { return "merge-blocks"; }
+    bool run(Function& fn, PassContext& ctx) override {
+        // Predecessor counts only change for merged blocks, whose single
+        // incoming edge simply moves to the block they are merged into.
+        std::map<BbId, size_t> npreds;
+        for (const auto& [label, preds] : ctx.am.get<CFGInfo>(fn).preds) {
+            npreds[label] = preds.size();
+        }
+
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            while (true) {
+                auto* jump = std::get_if<Jump>(&bb.term);
+                if (!jump) break;
+                BbId succ = jump->target;
+                if (succ == "entry" || succ == label || npreds[succ] != 1) break;
+                auto it = fn.body.find(succ);
+                if (it == fn.body.end()) break;
+
+                auto& insts = it->second.insts;
+                bb.insts.insert(bb.insts.end(), std::make_move_iterator(insts.begin()),
+                                std::make_move_iterator(insts.end()));
+                bb.term = std::move(it->second.term);
+                fn.body.erase(it);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+};
+
+class DcePass : public FunctionPass {
+public:
+    const char* name() const override { return "dce"; }
+    bool preserves_cfg() const override { return true; }
+    bool run(Function& fn, PassContext& ctx) override {
+        auto constants = constant_values(fn);
+        bool changed = false;
+        // Removing one dead instruction can make its operands dead too. The
+        // first round uses the cached liveness; later ones see our edits.
+        Liveness fresh;
+        const Liveness* live = &ctx.am.get<Liveness>(fn);
+        while (true) {
+            // Walk each block backwards from its live-out set; a removable
+            // instruction whose result is not live afterwards is dead.
+            std::pmr::vector<std::pair<BasicBlock*, std::pmr::vector<bool>>> dead(ctx.scratch);
+            DenseBitSet after;
+            for (auto& [label, bb] : fn.body) {
+                if (!live->sets.reached(label)) continue; // left to unreachable-blocks
+                after = live->sets.out_of(label);
+                live->step_backward(bb.term, after);
+                std::pmr::vector<bool> flags(bb.insts.size(), false, ctx.scratch);
+                bool any = false;
+                for (size_t i = bb.insts.size(); i-- > 0; ) {
+                    const VarId* def = inst_def(bb.insts[i]);
+                    uint32_t id = def ? live->vars.id(*def) : VarIndex::NONE;
+                    if (id != VarIndex::NONE && !after.test(id) && is_removable(bb.insts[i], constants)) {
+                        flags[i] = any = true;
+                        continue;
+                    }
+                    live->step_backward(bb.insts[i], after);
+                }
+                if (any) dead.emplace_back(&bb, std::move(flags));
+            }
+            if (dead.empty()) break;
+            for (auto& [bb, flags] : dead) {
+                size_t kept = 0;
+                for (size_t i = 0; i < bb->insts.size(); ++i) {
+                    if (flags[i]) continue;
+                    if (kept != i) bb->insts[kept] = std::move(bb->insts[i]);
+                    kept++;
+                }
+                bb->insts.resize(kept);
+            }
+            changed = true;
+            fresh = Liveness::compute(fn);
+            live = &fresh;
+        }
+        return changed;
+    }
+};
+
+class FuseBranchCmpPass : public FunctionPass {
+public:
+    const char* name() const override { return "fuse-branch-cmp"; }
+    bool preserves_cfg() const override { return true; }
+    bool run(Function& fn, PassContext& ctx) override {
+        // Fusing only rewrites the end of a block and does not change what is
+        // live into it, so one liveness result serves every block.
+        const Liveness& live = ctx.am.get<Liveness>(fn);
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            auto* branch = std::get_if<Branch>(&bb.term);
+            if (!branch || !live.sets.reached(label)) continue;
+            uint32_t guard = live.vars.id(branch->guard);
+            if (guard == VarIndex::NONE || live.sets.out_of(label).test(guard)) continue;
+
+            // The last write of the guard must be a $cmp whose operands still
+            // hold the compared values at the end of the block, and nothing
+            // in between may read the guard.
+            size_t i = bb.insts.size();
+            bool blocked = false;
+            while (i-- > 0) {
+                const VarId* def = inst_def(bb.insts[i]);
+                if (def && *def == branch->guard) break;
+                for_each_use(bb.insts[i], [&](const VarId& v) { blocked |= v == branch->guard; });
+            }
+            if (blocked || i == static_cast<size_t>(-1)) continue;
+            auto* cmp = std::get_if<Cmp>(&bb.insts[i]);
+            if (!cmp || cmp->left == cmp->lhs || cmp->right == cmp->lhs) continue;
+            for (size_t j = i + 1; j < bb.insts.size() && !blocked; ++j) {
+                const VarId* def = inst_def(bb.insts[j]);
+                blocked = def && (*def == cmp->left || *def == cmp->right);
+            }
+            if (blocked) continue;
+
+            bb.term = BranchCmp{cmp->rop, cmp->left, cmp->right, branch->tt, branch->ff};
+            bb.insts.erase(bb.insts.begin() + static_cast<std::ptrdiff_t>(i));
+            changed = true;
+        }
+        return changed;
+    }
+};
+
+class PruneLocalsPass : public FunctionPass {
+public:
+    const char* name() const override { return "prune-locals"; }
+    bool preserves_cfg() const override { return true; }
+    bool run(Function& fn, PassContext& ctx) override {
+        std::pmr::unordered_set<std::string_view> referenced(ctx.scratch);
+        auto mark = [&](const VarId& v) { referenced.insert(v); };
+        for (const auto& [label, bb] : fn.body) {
+            for (const auto& inst : bb.insts) {
+                if (const VarId* def = inst_def(inst)) referenced.insert(*def);
+                for_each_use(inst, mark);
+            }
+            for_each_term_use(bb.term, mark);
+        }
+
+        bool changed = false;
+        for (auto it = fn.locals.begin(); it != fn.locals.end(); ) {
+            if (is_temporary(it->first) && !referenced.count(it->first)) {
+                it = fn.locals.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+        return changed;
+    }
+};
+
+// --- Module Passes ---
+
+class DeadExternsPass : public ModulePass {
+public:
+    const char* name() const override { return "dead-externs"; }
+    bool run(Program& prog, AnalysisManager&) override {
+        std::set<VarId> referenced;
+        for (const auto& [fname, fn] : prog.functions) collect_references(fn, referenced);
+        return drop_unreferenced_externs(prog, referenced);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> create_unreachable_blocks_pass() { return std::make_unique<UnreachableBlocksPass>(); }
+std::unique_ptr<FunctionPass> create_const_fold_pass() { return std::make_unique<ConstFoldPass>(); }
+std::unique_ptr<FunctionPass> create_copy_prop_pass() { return std::make_unique<CopyPropPass>(); }
+std::unique_ptr<FunctionPass> create_jump_threading_pass() { return std::make_unique<JumpThreadingPass>(); }
+std::unique_ptr<FunctionPass> create_merge_blocks_pass() { return std::make_unique<MergeBlocksPass>(); }
+std::unique_ptr<FunctionPass> create_dce_pass() { return std::make_unique<DcePass>(); }
+std::unique_ptr<FunctionPass> create_fuse_branch_cmp_pass() { return std::make_unique<FuseBranchCmpPass>(); }
+std::unique_ptr<FunctionPass> create_prune_locals_pass() { return std::make_unique<PruneLocalsPass>(); }
+std::unique_ptr<ModulePass> create_dead_externs_pass() { return std::make_unique<DeadExternsPass>(); }
+
+void collect_references(const Function& fn, std::set<VarId>& referenced) {
+    auto mark = [&](const VarId& v) { referenced.insert(v); };
+    for (const auto& [label, bb] : fn.body) {
+        for (const auto& inst : bb.insts) for_each_use(inst, mark);
+        for_each_term_use(bb.term, mark);
+    }
+}
+
+bool drop_unreferenced_externs(Program& prog, const std::set<VarId>& referenced) {
+    bool changed = false;
+    for (auto it = prog.externs.begin(); it != prog.externs.end(); ) {
+        if (!referenced.count(it->first)) {
+            it = prog.externs.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    return changed;
+}
+
+} // namespace LIR
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pass_manager.hpp"
+#include <memory>
+#include <set>
+
+// Factories for the LIR optimization passes. The pass classes themselves
+// live in lir_passes.cpp; the pipelines that use them are assembled by
+// build_pipeline() in pass_manager.cpp.
+
+namespace LIR {
+
+// Removes blocks not reachable from `entry`. Returns true if any were removed.
+// Also used by the lowerer when it builds the CFG.
+bool remove_unreachable_blocks(Function& fn);
+
+// --- Function passes ---
+
+// "unreachable-blocks": remove_unreachable_blocks() as a pass
+std::unique_ptr<FunctionPass> create_unreachable_blocks_pass();
+// "const-fold": folds $arith/$cmp on constants, $select and $branch on a constant guard,
+// $branch_cmp on constant operands
+std::unique_ptr<FunctionPass> create_const_fold_pass();
+// "sccp": sparse conditional constant propagation across blocks (sccp.cpp)
+std::unique_ptr<FunctionPass> create_sccp_pass();
+// "gvn": removes instructions recomputing a value available from a dominator (gvn.cpp)
+std::unique_ptr<FunctionPass> create_gvn_pass();
+// "peephole": table-driven algebraic simplification and constant reassociation
+// within blocks, with a counter per rule (peephole.cpp)
+std::unique_ptr<FunctionPass> create_peephole_pass();
+// "copy-prop": forwards $copy sources to later uses within a block
+std::unique_ptr<FunctionPass> create_copy_prop_pass();
+// "jump-threading": retargets edges into empty `$jump`-only blocks
+std::unique_ptr<FunctionPass> create_jump_threading_pass();
+// "merge-blocks": merges a block into its only predecessor when that ends in a $jump
+std::unique_ptr<FunctionPass> create_merge_blocks_pass();
+// "dce": removes side-effect free instructions whose result is never used
+std::unique_ptr<FunctionPass> create_dce_pass();
+// "fuse-branch-cmp": turns `t = $cmp op a b` + `$branch t` into `$branch_cmp op a b`
+// when t is read nowhere else
+std::unique_ptr<FunctionPass> create_fuse_branch_cmp_pass();
+// "prune-locals": drops compiler temporaries that are no longer referenced
+std::unique_ptr<FunctionPass> create_prune_locals_pass();
+
+// --- Module passes ---
+
+// "dead-externs": removes externs that no function refers to
+std::unique_ptr<ModulePass> create_dead_externs_pass();
+// The same in two steps, for callers that never hold every function at once:
+// collect the names each function refers to, then drop the other externs
+void collect_references(const Function& fn, std::set<VarId>& referenced);
+bool drop_unreferenced_externs(Program& prog, const std::set<VarId>& referenced);
+
+} // namespace LIR
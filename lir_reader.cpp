@@ -0,0 +1,406 @@
+#include "lir_reader.hpp"
+#include <algorithm>
+#include <charconv>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace LIR {
+
+namespace {
+
+// Characters that end a name: everything the printer puts between operands
+bool is_delimiter(char c) {
+    switch (c) {
+        case ' ': case '\n': case ',': case '(': case ')':
+        case ':': case '{': case '}': case '[': case ']':
+            return true;
+    }
+    return false;
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view text) : m_text(text) {}
+
+    Program read() {
+        Program prog;
+        while (true) {
+            skip_blank_lines();
+            if (at_end()) break;
+            std::string_view keyword = word();
+            expect(' ');
+            if (keyword == "funptr") read_funptr(prog);
+            else if (keyword == "struct") read_struct(prog);
+            else if (keyword == "extern") read_extern(prog);
+            else if (keyword == "fn") read_function(prog);
+            else fail("unknown section '" + std::string(keyword) + "'");
+        }
+        return prog;
+    }
+
+private:
+    // --- Lexing ---
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("lir: line " + std::to_string(m_line) + ": " + what);
+    }
+
+    bool at_end() const { return m_pos == m_text.size(); }
+    char peek() const { return at_end() ? '\0' : m_text[m_pos]; }
+
+    bool accept(char c) {
+        if (peek() != c) return false;
+        ++m_pos;
+        return true;
+    }
+    bool accept(std::string_view lit) {
+        if (m_text.compare(m_pos, lit.size(), lit) != 0) return false;
+        m_pos += lit.size();
+        return true;
+    }
+    void expect(char c) {
+        if (!accept(c)) fail(std::string("expected '") + c + "'");
+    }
+    void expect(std::string_view lit) {
+        if (!accept(lit)) fail("expected '" + std::string(lit) + "'");
+    }
+
+    void end_line() {
+        expect('\n');
+        ++m_line;
+    }
+    void skip_blank_lines() {
+        while (accept('\n')) ++m_line;
+    }
+
+    std::string_view word() {
+        size_t start = m_pos;
+        while (!at_end() && !is_delimiter(m_text[m_pos])) ++m_pos;
+        if (m_pos == start) fail("expected a name");
+        return m_text.substr(start, m_pos - start);
+    }
+    std::string name() { return std::string(word()); }
+
+    int number() {
+        const char* first = m_text.data() + m_pos;
+        const char* last = m_text.data() + m_text.size();
+        int val = 0;
+        auto res = std::from_chars(first, last, val);
+        if (res.ec != std::errc() || (res.ptr != last && !is_delimiter(*res.ptr))) fail("expected an integer");
+        m_pos += static_cast<size_t>(res.ptr - first);
+        return val;
+    }
+
+    // " name": an operand after the first token of a line
+    std::string operand() {
+        expect(' ');
+        return name();
+    }
+
+    // --- Types ---
+
+    TypePtr type() {
+        if (accept('&')) {
+            if (peek() == '(') return std::make_shared<PtrType>(signature());
+            return std::make_shared<PtrType>(type());
+        }
+        if (accept('[')) {
+            TypePtr element = type();
+            expect(']');
+            return std::make_shared<ArrayType>(std::move(element));
+        }
+        if (accept("fn ")) return signature();
+        return atom(word());
+    }
+
+    // int, nil or a struct name; one object per spelling
+    TypePtr atom(std::string_view spelling) {
+        auto it = m_atoms.find(spelling);
+        if (it != m_atoms.end()) return it->second;
+        TypePtr t;
+        if (spelling == "int") t = std::make_shared<IntType>();
+        else if (spelling == "nil") t = std::make_shared<NilType>();
+        else t = std::make_shared<StructType>(std::string(spelling));
+        m_atoms.emplace(spelling, t);
+        return t;
+    }
+
+    // "(a, b) -> r"
+    std::shared_ptr<FnType> signature() {
+        expect('(');
+        std::vector<TypePtr> params;
+        if (!accept(')')) {
+            do params.push_back(type()); while (accept(", "));
+            expect(')');
+        }
+        expect(" -> ");
+        TypePtr ret = type();
+        return std::make_shared<FnType>(std::move(params), std::move(ret));
+    }
+
+    ArithOp arith_op() {
+        std::string_view op = word();
+        for (ArithOp aop : ARITH_OPS) {
+            if (op == arith_name(aop)) return aop;
+        }
+        fail("unknown arithmetic operator '" + std::string(op) + "'");
+    }
+
+    RelOp rel_op() {
+        std::string_view op = word();
+        for (RelOp rop : REL_OPS) {
+            if (op == rel_name(rop)) return rop;
+        }
+        fail("unknown comparison '" + std::string(op) + "'");
+    }
+
+    // --- Sections ---
+
+    void read_funptr(Program& prog) {
+        std::string fname = name();
+        expect(": ");
+        TypePtr t = type();
+        end_line();
+        if (!prog.funptrs.emplace(std::move(fname), std::move(t)).second) fail("duplicate funptr");
+    }
+
+    void read_struct(Program& prog) {
+        Struct s;
+        s.name = name();
+        expect(" {");
+        end_line();
+        while (!accept('}')) {
+            expect("  ");
+            std::string field = name();
+            expect(": ");
+            TypePtr t = type();
+            end_line();
+            size_t before = s.fields.size();
+            s.fields.emplace_hint(s.fields.end(), std::move(field), std::move(t));
+            if (s.fields.size() == before) fail("duplicate field");
+        }
+        end_line();
+        std::string sname = s.name;
+        if (!prog.structs.emplace(std::move(sname), std::move(s)).second) fail("duplicate struct");
+    }
+
+    void read_extern(Program& prog) {
+        std::string ename = name();
+        expect(": ");
+        // Externs print their signature without the `fn` keyword
+        TypePtr t = peek() == '(' ? signature() : type();
+        end_line();
+        if (!prog.externs.emplace(std::move(ename), std::move(t)).second) fail("duplicate extern");
+    }
+
+    void read_function(Program& prog) {
+        Function fn;
+        fn.name = name();
+        expect('(');
+        if (!accept(')')) {
+            do {
+                std::string param = name();
+                expect(':');
+                TypePtr t = type();
+                fn.locals.emplace(param, t);
+                fn.params.emplace_back(std::move(param), std::move(t));
+            } while (accept(", "));
+            expect(')');
+        }
+        expect(" -> ");
+        fn.rettyp = type();
+        expect(" {");
+        end_line();
+
+        if (accept("let ")) {
+            do {
+                std::string local = name();
+                expect(':');
+                TypePtr t = type();
+                size_t before = fn.locals.size();
+                fn.locals.emplace_hint(fn.locals.end(), std::move(local), std::move(t));
+                if (fn.locals.size() == before) fail("duplicate local");
+            } while (accept(", "));
+            end_line();
+        }
+
+        while (true) {
+            skip_blank_lines();
+            if (accept('}')) break;
+            BbId label = name();
+            expect(':');
+            end_line();
+            size_t before = fn.body.size();
+            auto it = fn.body.emplace_hint(fn.body.end(), label, BasicBlock{});
+            if (fn.body.size() == before) fail("duplicate block '" + label + "'");
+            it->second.label = std::move(label);
+            read_block(it->second);
+        }
+        end_line();
+
+        std::string fname = fn.name;
+        if (!prog.functions.emplace(std::move(fname), std::move(fn)).second) fail("duplicate function");
+    }
+
+    // Instructions up to and including the terminal
+    void read_block(BasicBlock& bb) {
+        while (true) {
+            expect("  ");
+            if (peek() != '$') {
+                bb.insts.push_back(definition());
+            } else if (accept("$store")) {
+                Store s;
+                s.dst = operand();
+                s.op = operand();
+                bb.insts.push_back(std::move(s));
+            } else if (accept("$call ")) {
+                bb.insts.push_back(call(std::nullopt));
+            } else {
+                bb.term = terminal();
+                end_line();
+                return;
+            }
+            end_line();
+        }
+    }
+
+    // "lhs = $op ..."
+    Inst definition() {
+        VarId lhs = name();
+        expect(" = $");
+        std::string_view op = word();
+        if (op == "const") {
+            expect(' ');
+            return Const{std::move(lhs), number()};
+        }
+        if (op == "copy") return Copy{std::move(lhs), operand()};
+        if (op == "arith") {
+            expect(' ');
+            ArithOp aop = arith_op();
+            VarId left = operand();
+            return Arith{std::move(lhs), aop, std::move(left), operand()};
+        }
+        if (op == "cmp") {
+            expect(' ');
+            RelOp rop = rel_op();
+            VarId left = operand();
+            return Cmp{std::move(lhs), rop, std::move(left), operand()};
+        }
+        if (op == "load") return Load{std::move(lhs), operand()};
+        if (op == "gfp") {
+            VarId src = operand();
+            expect(' ');
+            StructId sid = name();
+            expect("::");
+            return Gfp{std::move(lhs), std::move(src), std::move(sid), name()};
+        }
+        if (op == "gep") {
+            VarId src = operand();
+            VarId idx = operand();
+            bool checked;
+            if (accept(" [true]")) checked = true;
+            else if (accept(" [false]")) checked = false;
+            else fail("expected '[true]' or '[false]'");
+            return Gep{std::move(lhs), std::move(src), std::move(idx), checked};
+        }
+        if (op == "alloc_single") {
+            expect(' ');
+            return AllocSingle{std::move(lhs), type()};
+        }
+        if (op == "alloc_array") {
+            VarId amt = operand();
+            expect(' ');
+            return AllocArray{std::move(lhs), std::move(amt), type()};
+        }
+        if (op == "call") {
+            expect(' ');
+            return call(std::move(lhs));
+        }
+        if (op == "select") {
+            VarId guard = operand();
+            VarId tt = operand();
+            return Select{std::move(lhs), std::move(guard), std::move(tt), operand()};
+        }
+        fail("unknown instruction '$" + std::string(op) + "'");
+    }
+
+    // "callee(a, b)"; the arguments are stored in reverse order
+    Inst call(std::optional<VarId> lhs) {
+        Call c{std::move(lhs), name(), {}};
+        expect('(');
+        if (!accept(')')) {
+            do c.args.push_back(name()); while (accept(", "));
+            expect(')');
+        }
+        std::reverse(c.args.begin(), c.args.end());
+        return c;
+    }
+
+    Terminal terminal() {
+        expect('$');
+        std::string_view op = word();
+        if (op == "jump") return Jump{operand()};
+        if (op == "branch") {
+            VarId guard = operand();
+            BbId tt = operand();
+            return Branch{std::move(guard), std::move(tt), operand()};
+        }
+        if (op == "ret") {
+            if (peek() == '\n') return Ret{std::nullopt};
+            return Ret{operand()};
+        }
+        if (op == "branch_cmp") {
+            expect(' ');
+            RelOp rop = rel_op();
+            VarId left = operand();
+            VarId right = operand();
+            BbId tt = operand();
+            return BranchCmp{rop, std::move(left), std::move(right), std::move(tt), operand()};
+        }
+        if (op == "unreachable") return std::monostate{};
+        fail("unknown terminal '$" + std::string(op) + "'");
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+    size_t m_line = 1;
+    std::unordered_map<std::string_view, TypePtr> m_atoms;
+};
+
+} // namespace
+
+Program parse_lir(std::string_view text) {
+    return Reader(text).read();
+}
+
+Program read_lir_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("lir: cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("lir: cannot stat " + path);
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return Program{};
+    }
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) throw std::runtime_error("lir: cannot map " + path);
+    try {
+        Program prog = parse_lir(std::string_view(static_cast<const char*>(map), size));
+        ::munmap(map, size);
+        return prog;
+    } catch (...) {
+        ::munmap(map, size);
+        throw;
+    }
+}
+
+} // namespace LIR
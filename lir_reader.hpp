@@ -0,0 +1,22 @@
+#pragma once
+
+#include "lir.hpp"
+#include <string>
+#include <string_view>
+
+// Reads LIR text back into LIR::Program: the exact format of operator<< in
+// lir.hpp (and LirEmitter), so `.lir` outputs round-trip.
+//
+// The lexer hands out views into the input and only the names stored in the
+// program are copied. Atomic types (int, nil, struct names) are shared between
+// all their uses. Call arguments are stored reversed, as the lowerer does.
+
+namespace LIR {
+
+// Parses `text`. Throws std::runtime_error naming the line on malformed input.
+Program parse_lir(std::string_view text);
+
+// Reads the file at `path` and parses it
+Program read_lir_file(const std::string& path);
+
+} // namespace LIR
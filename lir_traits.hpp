@@ -0,0 +1,180 @@
+#pragma once
+
+#include "lir.hpp"
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Compile-time metadata for the LIR instructions: which operands are defined
+// and used, and what an instruction may do besides producing its result.
+// Every alternative of LIR::Inst has an InstTraits specialization; adding an
+// instruction without one fails to compile when INST_INFO is built.
+
+namespace LIR {
+
+// --- Instruction Metadata ---
+
+struct InstInfo {
+    const char* mnemonic;
+    bool has_def;        // writes a variable ($call only if it has a lhs)
+    bool side_effects;   // observable beyond its result: stores and calls
+    // May abort at run time. Of $arith only division can: add, sub and mul
+    // wrap on overflow, so passes may delete them when unused, fold them and
+    // reassociate them.
+    bool can_trap;
+    bool touches_memory; // reads, writes or allocates memory
+};
+
+// Each specialization provides:
+//   info          -- the InstInfo row
+//   def           -- pointer to the defined member, or nullptr
+//   uses          -- array of pointers to the VarId operands read
+//   variadic_uses -- pointer to a vector of further operands read, or nullptr
+template <typename T>
+struct InstTraits;
+
+template <>
+struct InstTraits<Const> {
+    static constexpr InstInfo info{"$const", true, false, false, false};
+    static constexpr auto def = &Const::lhs;
+    static constexpr std::array<VarId Const::*, 0> uses{};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Copy> {
+    static constexpr InstInfo info{"$copy", true, false, false, false};
+    static constexpr auto def = &Copy::lhs;
+    static constexpr std::array<VarId Copy::*, 1> uses{&Copy::op};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Arith> {
+    static constexpr InstInfo info{"$arith", true, false, true, false};
+    static constexpr auto def = &Arith::lhs;
+    static constexpr std::array<VarId Arith::*, 2> uses{&Arith::left, &Arith::right};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Cmp> {
+    static constexpr InstInfo info{"$cmp", true, false, false, false};
+    static constexpr auto def = &Cmp::lhs;
+    static constexpr std::array<VarId Cmp::*, 2> uses{&Cmp::left, &Cmp::right};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Load> {
+    static constexpr InstInfo info{"$load", true, false, true, true};
+    static constexpr auto def = &Load::lhs;
+    static constexpr std::array<VarId Load::*, 1> uses{&Load::src};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Store> {
+    static constexpr InstInfo info{"$store", false, true, true, true};
+    static constexpr std::nullptr_t def = nullptr;
+    static constexpr std::array<VarId Store::*, 2> uses{&Store::dst, &Store::op};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Gfp> {
+    static constexpr InstInfo info{"$gfp", true, false, true, false};
+    static constexpr auto def = &Gfp::lhs;
+    static constexpr std::array<VarId Gfp::*, 1> uses{&Gfp::src};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Gep> {
+    static constexpr InstInfo info{"$gep", true, false, true, false};
+    static constexpr auto def = &Gep::lhs;
+    static constexpr std::array<VarId Gep::*, 2> uses{&Gep::src, &Gep::idx};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<AllocSingle> {
+    static constexpr InstInfo info{"$alloc_single", true, false, false, true};
+    static constexpr auto def = &AllocSingle::lhs;
+    static constexpr std::array<VarId AllocSingle::*, 0> uses{};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<AllocArray> {
+    static constexpr InstInfo info{"$alloc_array", true, false, true, true};
+    static constexpr auto def = &AllocArray::lhs;
+    static constexpr std::array<VarId AllocArray::*, 1> uses{&AllocArray::amt};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+template <>
+struct InstTraits<Call> {
+    static constexpr InstInfo info{"$call", true, true, true, true};
+    static constexpr auto def = &Call::lhs; // std::optional<VarId>
+    static constexpr std::array<VarId Call::*, 1> uses{&Call::callee};
+    static constexpr auto variadic_uses = &Call::args;
+};
+
+template <>
+struct InstTraits<Select> {
+    static constexpr InstInfo info{"$select", true, false, false, false};
+    static constexpr auto def = &Select::lhs;
+    static constexpr std::array<VarId Select::*, 3> uses{&Select::guard, &Select::tt, &Select::ff};
+    static constexpr std::nullptr_t variadic_uses = nullptr;
+};
+
+// --- Table ---
+
+template <size_t... I>
+constexpr std::array<InstInfo, sizeof...(I)> make_inst_info_table(std::index_sequence<I...>) {
+    return {{InstTraits<std::variant_alternative_t<I, Inst>>::info...}};
+}
+
+// INST_INFO[inst.index()] describes `inst`
+inline constexpr auto INST_INFO = make_inst_info_table(std::make_index_sequence<std::variant_size_v<Inst>>{});
+
+inline const InstInfo& inst_info(const Inst& inst) { return INST_INFO[inst.index()]; }
+
+// --- Generic Operand Access ---
+
+// Variable defined by a concrete instruction, or nullptr. Const-ness follows `inst`.
+template <typename T>
+auto def_of(T& inst) {
+    using Tr = InstTraits<std::remove_const_t<T>>;
+    using Result = std::conditional_t<std::is_const_v<T>, const VarId*, VarId*>;
+    if constexpr (std::is_null_pointer_v<std::decay_t<decltype(Tr::def)>>) {
+        return Result{nullptr};
+    } else if constexpr (std::is_same_v<std::decay_t<decltype(inst.*Tr::def)>, VarId>) {
+        return Result{&(inst.*Tr::def)};
+    } else {
+        auto& opt = inst.*Tr::def;
+        return opt ? Result{&*opt} : Result{nullptr};
+    }
+}
+
+// Calls f(VarId&) on every operand a concrete instruction reads.
+template <typename T, typename F>
+void for_each_use_of(T& inst, F&& f) {
+    using Tr = InstTraits<std::remove_const_t<T>>;
+    for (auto member : Tr::uses) f(inst.*member);
+    if constexpr (!std::is_null_pointer_v<std::decay_t<decltype(Tr::variadic_uses)>>) {
+        for (auto& v : inst.*Tr::variadic_uses) f(v);
+    }
+}
+
+// Calls f(VarId&) on the variable a concrete instruction defines, if any, and
+// then on every operand it reads.
+template <typename T, typename F>
+void for_each_operand_of(T& inst, F&& f) {
+    if (auto* def = def_of(inst)) f(*def);
+    for_each_use_of(inst, f);
+}
+
+} // namespace LIR
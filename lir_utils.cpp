@@ -0,0 +1,112 @@
+#include "lir_utils.hpp"
+#include <climits>
+
+namespace LIR {
+
+VarId const_name(int n) {
+    // Widen before negating so INT_MIN gets a sensible name
+    long long v = n;
+    return "_const_" + (v < 0 ? "n" + std::to_string(-v) : std::to_string(v));
+}
+
+VarId ensure_const(Function& fn, int n) {
+    VarId name = const_name(n);
+
+    // The lowerer emits all constants first in the entry block, sorted by name;
+    // insert the new one at its sorted position within that prefix. The local
+    // may outlive its instruction (DCE leaves locals to prune-locals), so look
+    // for the instruction, not the local.
+    auto& insts = fn.body.at("entry").insts;
+    auto it = insts.begin();
+    while (it != insts.end()) {
+        auto* c = std::get_if<Const>(&*it);
+        if (!c || c->lhs > name) break;
+        if (c->lhs == name) return name;
+        ++it;
+    }
+    insts.insert(it, Const{name, n});
+    fn.locals[name] = std::make_shared<IntType>();
+    return name;
+}
+
+std::map<VarId, int> constant_values(const Function& fn) {
+    std::map<VarId, int> values;
+    std::map<VarId, int> def_count;
+    for (const auto& [label, bb] : fn.body) {
+        for (const auto& inst : bb.insts) {
+            if (const VarId* def = inst_def(inst)) def_count[*def]++;
+        }
+    }
+
+    // Only the leading $const run of the entry block is known to precede every use
+    auto entry = fn.body.find("entry");
+    if (entry == fn.body.end()) return values;
+    for (const auto& inst : entry->second.insts) {
+        auto* c = std::get_if<Const>(&inst);
+        if (!c) break;
+        if (def_count[c->lhs] == 1) values[c->lhs] = c->val;
+    }
+    // A parameter redefined by a $const still has its incoming value before that
+    for (const auto& [pname, ptype] : fn.params) {
+        values.erase(pname);
+    }
+    return values;
+}
+
+std::optional<int> fold_arith(ArithOp aop, int left, int right) {
+    long long l = left, r = right, v = 0;
+    switch (aop) {
+        case ArithOp::Add: v = l + r; break;
+        case ArithOp::Sub: v = l - r; break;
+        case ArithOp::Mul: v = l * r; break;
+        case ArithOp::Div:
+            if (r == 0) return std::nullopt;
+            v = l / r; // C++ truncates toward zero, like the target
+            break;
+    }
+    if (v < INT_MIN || v > INT_MAX) return std::nullopt;
+    return static_cast<int>(v);
+}
+
+int fold_cmp(RelOp rop, int left, int right) {
+    switch (rop) {
+        case RelOp::Eq:    return left == right;
+        case RelOp::NotEq: return left != right;
+        case RelOp::Lt:    return left < right;
+        case RelOp::Lte:   return left <= right;
+        case RelOp::Gt:    return left > right;
+        case RelOp::Gte:   return left >= right;
+    }
+    return 0;
+}
+
+std::vector<BbId> successors(const Terminal& term) {
+    if (auto* jump = std::get_if<Jump>(&term)) {
+        return {jump->target};
+    }
+    if (auto* branch = std::get_if<Branch>(&term)) {
+        return {branch->tt, branch->ff};
+    }
+    if (auto* bc = std::get_if<BranchCmp>(&term)) {
+        return {bc->tt, bc->ff};
+    }
+    return {};
+}
+
+size_t count_insts(const Function& fn) {
+    size_t n = 0;
+    for (const auto& [label, bb] : fn.body) {
+        n += bb.insts.size() + 1; // +1 for the terminal
+    }
+    return n;
+}
+
+size_t count_insts(const Program& prog) {
+    size_t n = 0;
+    for (const auto& [name, fn] : prog.functions) {
+        n += count_insts(fn);
+    }
+    return n;
+}
+
+} // namespace LIR
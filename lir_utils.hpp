@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lir.hpp"
+#include "lir_traits.hpp"
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Small helpers shared by the lowerer and the LIR passes.
+
+namespace LIR {
+
+// Name of the variable holding the constant `n`: `_const_<n>`, with an `n`
+// prefix instead of `-` for negative values (see lower.md).
+VarId const_name(int n);
+
+// Returns `_const_<n>`, creating the local and its `$const` instruction at
+// the top of the entry block (keeping the leading constants sorted by name)
+// if the function does not have it yet.
+VarId ensure_const(Function& fn, int n);
+
+// Maps every variable whose only definition is a `$const` to its value.
+std::map<VarId, int> constant_values(const Function& fn);
+
+// Evaluates `left aop right`; nullopt if it would trap, or if the result
+// would wrap: the fold is left to run time rather than spelled as a
+// wrapped `$const`.
+std::optional<int> fold_arith(ArithOp aop, int left, int right);
+// Evaluates `left rop right` as 0 or 1.
+int fold_cmp(RelOp rop, int left, int right);
+
+// Variable defined by an instruction, if any.
+inline const VarId* inst_def(const Inst& inst) {
+    return std::visit([](const auto& arg) -> const VarId* { return def_of(arg); }, inst);
+}
+
+// Calls f(VarId&) on every variable read by an instruction.
+// Works for both const and non-const instructions so passes can rewrite uses in place.
+template <typename I, typename F>
+void for_each_use(I& inst, F&& f) {
+    std::visit([&f](auto& arg) { for_each_use_of(arg, f); }, inst);
+}
+
+// Calls f(VarId&) on every variable an instruction defines or reads.
+template <typename I, typename F>
+void for_each_operand(I& inst, F&& f) {
+    std::visit([&f](auto& arg) { for_each_operand_of(arg, f); }, inst);
+}
+
+// Calls f(VarId&) on every variable read by a terminal.
+template <typename F>
+void for_each_term_use(Terminal& term, F&& f) {
+    if (auto* br = std::get_if<Branch>(&term)) f(br->guard);
+    else if (auto* ret = std::get_if<Ret>(&term)) { if (ret->val) f(*ret->val); }
+    else if (auto* bc = std::get_if<BranchCmp>(&term)) { f(bc->left); f(bc->right); }
+}
+template <typename F>
+void for_each_term_use(const Terminal& term, F&& f) {
+    if (auto* br = std::get_if<Branch>(&term)) f(br->guard);
+    else if (auto* ret = std::get_if<Ret>(&term)) { if (ret->val) f(*ret->val); }
+    else if (auto* bc = std::get_if<BranchCmp>(&term)) { f(bc->left); f(bc->right); }
+}
+
+// Successor labels of a terminal, in (tt, ff) order for branches.
+std::vector<BbId> successors(const Terminal& term);
+
+// Number of instructions plus terminals in a function / program.
+size_t count_insts(const Function& fn);
+size_t count_insts(const Program& prog);
+
+} // namespace LIR
@@ -0,0 +1,55 @@
+#include "lir_verifier.hpp"
+#include "lir_utils.hpp"
+#include <stdexcept>
+
+namespace LIR {
+
+namespace {
+
+class Verifier {
+public:
+    Verifier(const Program& prog, const Function& fn) : m_prog(prog), m_fn(fn) {}
+
+    void run() {
+        if (!m_fn.body.count("entry")) fail("no entry block");
+        for (const auto& [label, bb] : m_fn.body) {
+            m_block = &label;
+            for (const auto& inst : bb.insts) {
+                for_each_use(inst, [&](const VarId& v) { check_operand(v); });
+                if (const VarId* def = inst_def(inst)) {
+                    if (!m_fn.locals.count(*def)) fail("assignment to non-local " + *def);
+                }
+            }
+            if (std::holds_alternative<std::monostate>(bb.term)) fail("missing terminal");
+            for_each_term_use(bb.term, [&](const VarId& v) { check_operand(v); });
+            for (const auto& succ : successors(bb.term)) {
+                if (!m_fn.body.count(succ)) fail("branch to unknown block " + succ);
+            }
+        }
+    }
+
+private:
+    void check_operand(const VarId& v) const {
+        if (m_fn.locals.count(v) || v == "__NULL") return;
+        if (m_prog.functions.count(v) || m_prog.externs.count(v) || m_prog.funptrs.count(v)) return;
+        fail("use of undeclared " + v);
+    }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        std::string where = "LIR verifier: function " + m_fn.name;
+        if (m_block) where += ", block " + *m_block;
+        throw std::runtime_error(where + ": " + what);
+    }
+
+    const Program& m_prog;
+    const Function& m_fn;
+    const BbId* m_block = nullptr;
+};
+
+} // namespace
+
+void verify(const Program& prog) {
+    for (const auto& [name, fn] : prog.functions) Verifier(prog, fn).run();
+}
+
+} // namespace LIR
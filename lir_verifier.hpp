@@ -0,0 +1,18 @@
+#pragma once
+
+#include "lir.hpp"
+
+// Structural checks on a LIR program, for catching malformed output of the
+// lowerer or a pass early (see --verify in main.cpp).
+
+namespace LIR {
+
+// Throws std::runtime_error naming the function and block of the first
+// problem found:
+//   - every function has an `entry` block and every block a terminal
+//   - branch and jump targets are blocks of the same function
+//   - every operand is a local, parameter, function, extern, funptr or __NULL
+//   - every defined variable is a local or parameter of the function
+void verify(const Program& prog);
+
+} // namespace LIR
@@ -1,4 +1,6 @@
 #include "lowerer.hpp"
+#include "lir_passes.hpp"
+#include "lir_utils.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
@@ -14,9 +16,40 @@ std::unique_ptr<LIR::Program> Lowerer::lower(AST::Program* ast_prog) {
     return std::move(m_lir_prog);
 }
 
+// --- Streaming ---
+
+LIR::Program& Lowerer::begin_module(AST::Program* signatures) {
+    m_lir_prog = std::make_unique<LIR::Program>();
+    lower_module_decls(signatures);
+    return *m_lir_prog;
+}
+
+LIR::Function Lowerer::lower_function(AST::FunctionDef* fun) {
+    m_lir_prog->functions[fun->name] = make_function_shell(fun);
+    fun->accept(*this);
+    m_tv.clear();
+    auto node = m_lir_prog->functions.extract(fun->name);
+    return std::move(node.mapped());
+}
+
 // --- Visitor Implementations: Top-Level ---
 
 void Lowerer::visit(AST::Program* n) {
+    // 1. Structs, externs and funptrs
+    lower_module_decls(n);
+
+    // 2. Create function shells
+    for (const auto& ast_fun : n->functions) {
+        m_lir_prog->functions[ast_fun->name] = make_function_shell(ast_fun.get());
+    }
+
+    // 3. Lower each function's body
+    for (const auto& ast_fun : n->functions) {
+        ast_fun->accept(*this);
+    }
+}
+
+void Lowerer::lower_module_decls(AST::Program* n) {
     // 1. Copy structs
     for (const auto& ast_struct : n->structs) {
         ast_struct->accept(*this);
@@ -32,38 +65,32 @@ void Lowerer::visit(AST::Program* n) {
         m_lir_prog->externs[ast_extern.name] = std::make_shared<LIR::FnType>(param_types, ret_type);
     }
 
-    // 3. Create function shells and populate funptrs (for internal functions)
+    // 3. Populate funptrs (for internal functions)
     // ∀`f` ∈ `prog.functions` \ {`main`}: `lir.funptrs` += [`f.name` ⟶ `Ptr(Fn(f.params.types, f.rettyp))`].
     for (const auto& ast_fun : n->functions) {
-        LIR::Function lir_fun;
-        lir_fun.name = ast_fun->name;
-        lir_fun.rettyp = convert_type(ast_fun->rettype);
-
+        if (ast_fun->name == "main") continue;
         std::vector<LIR::TypePtr> param_types;
         for (const auto& p : ast_fun->params) {
-            LIR::TypePtr param_type = convert_type(p.type);
-            lir_fun.params.push_back({p.name, param_type});
-            param_types.push_back(param_type);
-            lir_fun.locals[p.name] = param_type; // Add params to locals map
-        }
-        
-        for (const auto& l : ast_fun->locals) {
-            lir_fun.locals[l.name] = convert_type(l.type);
-        }
-
-        // Add to funptrs (except main)
-        if (lir_fun.name != "main") {
-            auto fn_type = std::make_shared<LIR::FnType>(param_types, lir_fun.rettyp);
-            m_lir_prog->funptrs[lir_fun.name] = std::make_shared<LIR::PtrType>(fn_type);
+            param_types.push_back(convert_type(p.type));
         }
-
-        m_lir_prog->functions[lir_fun.name] = std::move(lir_fun);
+        auto fn_type = std::make_shared<LIR::FnType>(param_types, convert_type(ast_fun->rettype));
+        m_lir_prog->funptrs[ast_fun->name] = std::make_shared<LIR::PtrType>(fn_type);
     }
+}
 
-    // 4. Lower each function's body
-    for (const auto& ast_fun : n->functions) {
-        ast_fun->accept(*this);
+LIR::Function Lowerer::make_function_shell(AST::FunctionDef* fun) {
+    LIR::Function lir_fun;
+    lir_fun.name = fun->name;
+    lir_fun.rettyp = convert_type(fun->rettype);
+    for (const auto& p : fun->params) {
+        LIR::TypePtr param_type = convert_type(p.type);
+        lir_fun.params.push_back({p.name, param_type});
+        lir_fun.locals[p.name] = param_type; // Add params to locals map
+    }
+    for (const auto& l : fun->locals) {
+        lir_fun.locals[l.name] = convert_type(l.type);
     }
+    return lir_fun;
 }
 
 void Lowerer::visit(AST::StructDef* n) {
@@ -198,17 +225,13 @@ void Lowerer::visit(AST::If* n) {
     LIR::BbId END = new_label();
     
     //   let x = ⟦guard⟧ᵉ
-    LIR::VarId x = lower_exp(n->guard.get());
-    
     //   % Branch(x, TT, FF)
-    m_tv.push_back(LIR::Branch{x, TT, FF});
+    //   release([x])
+    lower_branch(n->guard.get(), TT, FF);
     
     //   % Label(TT)
     m_tv.push_back(TvLabel{TT});
     
-    //   release([x])
-    release({x});
-    
     //   ⟦tt⟧ˢ
     lower_stmt(n->tt.get());
     
@@ -246,11 +269,9 @@ void Lowerer::visit(AST::While* n) {
     //   % Label(LOOP_HDR)
     m_tv.push_back(TvLabel{LOOP_HDR});
     //   let x = ⟦guard⟧ᵉ
-    LIR::VarId x = lower_exp(n->guard.get());
     //   % Branch(x, BODY, LOOP_END)
-    m_tv.push_back(LIR::Branch{x, BODY, LOOP_END});
     //   release([x])
-    release({x});
+    lower_branch(n->guard.get(), BODY, LOOP_END);
     //   % Label(BODY)
     m_tv.push_back(TvLabel{BODY});
     //   ⟦body⟧ˢ
@@ -346,6 +367,25 @@ void Lowerer::visit(AST::NilExp* n) {
 }
 
 void Lowerer::visit(AST::Select* n) {
+    int budget = 2;
+    if (m_options.branchless_select && is_cheap(n->tt.get(), budget) && is_cheap(n->ff.get(), budget)) {
+        // Both arms are evaluated, then $select picks one:
+        //   let y = ⟦g⟧ᵉ, z = ⟦tt⟧ᵉ, w = ⟦ff⟧ᵉ
+        //   let x = fresh_non_inner_var(typeof(z or w))
+        //   % Select(x, y, z, w)
+        LIR::VarId y = lower_exp(n->guard.get());
+        LIR::VarId z = lower_exp(n->tt.get());
+        LIR::VarId w = lower_exp(n->ff.get());
+        LIR::VarId x = "__NULL";
+        if (z != "__NULL" || w != "__NULL") {
+            x = fresh_non_inner_var(typeof_var(z != "__NULL" ? z : w));
+            m_tv.push_back(LIR::Select{x, y, z, w});
+        }
+        release({y, z, w});
+        m_last_result_id = x;
+        return;
+    }
+
     // TODO: Implement this based on ⟦Select(g, tt, ff)⟧ᵉ
     // This one is tricky! Follow the spec carefully about checking
     // if z == "__NULL" and w == "__NULL".
@@ -812,13 +852,52 @@ void Lowerer::release(std::vector<LIR::VarId> vars) {
     }
 }
 
+void Lowerer::lower_branch(AST::Exp* guard, const LIR::BbId& TT, const LIR::BbId& FF) {
+    auto bin = dynamic_cast<AST::BinOp*>(guard);
+    bool relational = bin && (bin->op == AST::BinaryOp::Eq || bin->op == AST::BinaryOp::NotEq ||
+                              bin->op == AST::BinaryOp::Lt || bin->op == AST::BinaryOp::Lte ||
+                              bin->op == AST::BinaryOp::Gt || bin->op == AST::BinaryOp::Gte);
+    if (m_options.fuse_branch_cmp && relational) {
+        // The comparison result is only used by the branch: skip the temporary
+        LIR::VarId op1 = lower_exp(bin->left.get());
+        LIR::VarId op2 = lower_exp(bin->right.get());
+        m_tv.push_back(LIR::BranchCmp{convert_rel_op(bin->op), op1, op2, TT, FF});
+        release({op1, op2});
+        return;
+    }
+    LIR::VarId x = lower_exp(guard);
+    m_tv.push_back(LIR::Branch{x, TT, FF});
+    release({x});
+}
+
+bool Lowerer::is_cheap(AST::Exp* exp, int& budget) {
+    if (dynamic_cast<AST::Num*>(exp) || dynamic_cast<AST::NilExp*>(exp)) return true;
+    if (auto val = dynamic_cast<AST::Val*>(exp)) {
+        // Reading a variable is free; derefs, array and field accesses can trap
+        return dynamic_cast<AST::Id*>(val->place.get()) != nullptr;
+    }
+    if (--budget < 0) return false;
+    if (auto un = dynamic_cast<AST::UnOp*>(exp)) return is_cheap(un->exp.get(), budget);
+    if (auto bin = dynamic_cast<AST::BinOp*>(exp)) {
+        switch (bin->op) {
+            case AST::BinaryOp::Div: // traps on zero
+            case AST::BinaryOp::And: // lowered with branches
+            case AST::BinaryOp::Or:
+                return false;
+            default:
+                return is_cheap(bin->left.get(), budget) && is_cheap(bin->right.get(), budget);
+        }
+    }
+    return false;
+}
+
 // Returns a variable whose value is the constant `n`. If one doesn't currently exist then 
 // (1) creates the variable and inserts it into the function's local variables, and 
 // (2) records it for later insertion.
 // named `_const_<num>`, where `<num>` is the constant value (negative values should have an `n` in front instead of a `-`).
 LIR::VarId Lowerer::const_var(int n) {
     // ⟦const(n)⟧
-    std::string name = "_const_" + (n < 0 ? "n" + std::to_string(-n) : std::to_string(n));
+    std::string name = LIR::const_name(n);
     
     if (m_current_fun->locals.find(name) == m_current_fun->locals.end()) {
         // Not found, create it and insert into locals
@@ -1011,53 +1090,6 @@ void Lowerer::build_cfg() {
 }
 
 void Lowerer::remove_unreachable_blocks() {
-    // Find all reachable blocks starting from entry block
-    std::set<LIR::BbId> reachable;
-    std::vector<LIR::BbId> worklist;
-    
-    // Start from entry block
-    LIR::BbId entry_label = "entry";
-    worklist.push_back(entry_label);
-    reachable.insert(entry_label);
-    
-    // BFS to find all reachable blocks
-    while (!worklist.empty()) {
-        LIR::BbId current = worklist.back();
-        worklist.pop_back();
-        
-        // Get the basic block
-        auto it = m_current_fun->body.find(current);
-        if (it == m_current_fun->body.end()) {
-            continue;
-        }
-        
-        const LIR::BasicBlock& bb = it->second;
-        
-        // Get successor blocks from the terminal
-        if (auto* jump = std::get_if<LIR::Jump>(&bb.term)) {
-            if (reachable.find(jump->target) == reachable.end()) {
-                reachable.insert(jump->target);
-                worklist.push_back(jump->target);
-            }
-        } else if (auto* branch = std::get_if<LIR::Branch>(&bb.term)) {
-            if (reachable.find(branch->tt) == reachable.end()) {
-                reachable.insert(branch->tt);
-                worklist.push_back(branch->tt);
-            }
-            if (reachable.find(branch->ff) == reachable.end()) {
-                reachable.insert(branch->ff);
-                worklist.push_back(branch->ff);
-            }
-        }
-        // Ret has no successors, so we don't need to handle it
-    }
-    
-    // Remove unreachable blocks
-    for (auto it = m_current_fun->body.begin(); it != m_current_fun->body.end(); ) {
-        if (reachable.find(it->first) == reachable.end()) {
-            it = m_current_fun->body.erase(it);
-        } else {
-            ++it;
-        }
-    }
-}
\ No newline at end of file
+    // Shared with the "unreachable-blocks" optimization pass
+    LIR::remove_unreachable_blocks(*m_current_fun);
+}
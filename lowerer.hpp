@@ -14,13 +14,34 @@ using TranslationItem = std::variant<
     LIR::Terminal
 >;
 
+// Opt-in lowering variants. The defaults produce the reference lowering.
+struct LowerOptions {
+    // Lower a Select whose arms are cheap and side-effect free to a $select
+    // instead of a branch, two arm blocks and a merge block
+    bool branchless_select = false;
+    // Branch on a comparison guard of an If or While with a single
+    // $branch_cmp instead of a $cmp into a temporary and a $branch
+    bool fuse_branch_cmp = false;
+};
+
 class Lowerer : public ASTVisitor {
 public:
     Lowerer() = default;
+    explicit Lowerer(LowerOptions options) : m_options(options) {}
+
+    const LowerOptions& options() const { return m_options; }
 
     // Main entry point
     std::unique_ptr<LIR::Program> lower(AST::Program* ast_prog);
 
+    // --- Streaming ---
+    // Lowers structs, externs and the funptrs of `signatures`, whose function
+    // bodies may be missing. The returned program has no functions; it stays
+    // owned by the lowerer and valid until the next lower()/begin_module().
+    LIR::Program& begin_module(AST::Program* signatures);
+    // Lowers one function (with its body) against the module of begin_module()
+    LIR::Function lower_function(AST::FunctionDef* fun);
+
     // --- Visitor Methods ---    
     // Top-level
     void visit(AST::Program* n) override;
@@ -62,6 +83,7 @@ public:
 
 private:
     // --- State ---
+    LowerOptions m_options;
     std::unique_ptr<LIR::Program> m_lir_prog;
     LIR::Function* m_current_fun = nullptr;
     std::vector<TranslationItem> m_tv; // The Translation Vector
@@ -108,6 +130,13 @@ private:
     // ⟦label()⟧
     LIR::BbId new_label();
 
+    // Lowers `guard` and branches on it to TT or FF, releasing its operands
+    void lower_branch(AST::Exp* guard, const LIR::BbId& TT, const LIR::BbId& FF);
+
+    // True if `exp` may be evaluated unconditionally as a $select arm: at most
+    // `budget` operations on constants and variables, none of which can trap
+    static bool is_cheap(AST::Exp* exp, int& budget);
+
     // ⟦typeof(x)⟧
     LIR::TypePtr typeof_var(LIR::VarId id);
     
@@ -123,6 +152,11 @@ private:
     // Helper to get function return type
     LIR::TypePtr typeof_func_ret(LIR::TypePtr fn_type);
 
+    // Structs and externs of `n`, and a funptr for every function but main
+    void lower_module_decls(AST::Program* n);
+    // The function without its body: params, locals and return type
+    LIR::Function make_function_shell(AST::FunctionDef* fun);
+
     // --- Pass 2: TV -> CFG ---
     void build_cfg();
     void remove_unreachable_blocks();
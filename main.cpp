@@ -1,57 +1,522 @@
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
 
 #include "json.hpp"     // Your JSON library
 #include "ast.hpp"      // Your AST header
 #include "lowerer.hpp"    // Our new lowerer
+#include "pass_manager.hpp" // LIR optimization pipeline
+#include "lir_verifier.hpp" // --verify
+#include "lir_emitter.hpp"  // buffered output
+#include "lir_binary.hpp"   // -o lirb
+#include "streaming.hpp"    // --stream
+#include "spill.hpp"        // --mem-limit
+#include "lir_reader.hpp"   // .lir input
+#include "lir_dot.hpp"      // --dot
+#include "batch.hpp"        // --batch
+#include "output_cache.hpp" // --cache-dir
+#include "watch.hpp"        // --watch
+#include "jsonl.hpp"        // --jsonl
+#include "lir_link.hpp"     // several inputs
 
 // This function must be defined in your ast.cpp
 std::unique_ptr<AST::Program> buildProgram(const nlohmann::json& j);
 
+// Parses the N of a --flag=N option; returns false if it is not a number.
+static bool parse_count(const std::string& arg, size_t prefix_len, size_t& out) {
+    try {
+        size_t pos = 0;
+        out = std::stoul(arg.substr(prefix_len), &pos);
+        return pos == arg.size() - prefix_len;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Everything besides the input that changes the output, for cache keys
+static std::string describe_output(int opt_level, const LowerOptions& lower, OutputFormat format) {
+    return "-O" + std::to_string(opt_level) + " branchless_select=" + std::to_string(lower.branchless_select) +
+           " fuse_branch_cmp=" + std::to_string(lower.fuse_branch_cmp) +
+           " format=" + std::to_string(static_cast<int>(format));
+}
+
+static void print_usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options] <file.astj|file.lir|file.lirb>...\n"
+              << "       " << argv0 << " [options] --batch <dir|list> --out <dir>\n"
+              << "       " << argv0 << " [options] --watch <dir> --out <dir>\n"
+              << "       " << argv0 << " [options] --jsonl[=records] [file.jsonl]  (default: stdin)\n"
+              << "LIR inputs (text or lirb, by extension) skip lowering and go straight to\n"
+              << "the optimizer. Several inputs are modules of one program: they are lowered in\n"
+              << "parallel and linked, resolving externs to the functions of other modules.\n"
+              << "Options:\n"
+              << "  -O0, -O1, -O2    optimization level (default -O0: reference output)\n"
+              << "  --time-passes    report per-pass time and instruction counts on stderr\n"
+              << "  --threads=N      run function passes and output rendering on N threads\n"
+              << "                   (0 = all cores, default 1)\n"
+              << "  --branchless-select\n"
+              << "                   lower selects with cheap arms to $select instead of branches\n"
+              << "  --fuse-branch-cmp\n"
+              << "                   branch on comparisons with $branch_cmp instead of $cmp + $branch\n"
+              << "  --verify         check the LIR after lowering and after optimization\n"
+              << "  -o FORMAT        output format: text (default), lirb (binary, see lir_binary.hpp)\n"
+              << "                   or json (see lir_json.hpp)\n"
+              << "  --stream         lower, optimize and print one function at a time (-O0/-O1, text only)\n"
+              << "  --mem-limit=N    keep about N bytes of lowered functions in memory and spill the rest\n"
+              << "                   to a temporary file until output (.astj input, text only)\n"
+              << "  --dot=F[,G...]   print the CFGs of the named functions as Graphviz instead of the program\n"
+              << "  --profile=FILE   shade --dot blocks by the execution counts in FILE (see lir_dot.hpp)\n"
+              << "  --batch SRC      lower every input of directory SRC (or listed in file SRC, one per\n"
+              << "                   line) in this process, into one output file each under --out\n"
+              << "  --out DIR        output directory for --batch and --watch\n"
+              << "  --watch DIR      lower the .astj inputs of DIR into --out, then re-lower the functions\n"
+              << "                   that change whenever an input is rewritten, until interrupted\n"
+              << "  --jsonl          read one AST program per line and write each one's LIR after an\n"
+              << "                   ASCII record separator (0x1e), in input order\n"
+              << "  --jsonl=records  the same, written as JSON lines {\"line\": N, \"lir\": \"...\"}\n"
+              << "  --cache-dir=DIR  reuse the output of inputs lowered before with the same options\n"
+              << "                   (see output_cache.hpp); not used with --verify or --time-passes, whose\n"
+              << "                   checks and reports need the input lowered again\n"
+              << "  --cache-size=N   evict the least recently used cache entries beyond N bytes\n"
+              << "                   (default 512 MiB)\n"
+              << "  --cache-stats    print the counters of the --cache-dir cache and exit\n";
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <file.astj>\n";
+    // 0. Parse command-line options
+    int opt_level = 0;
+    bool time_passes = false;
+    bool fuse_branch_cmp = false;
+    bool verify = false;
+    OutputFormat output_format = OutputFormat::Text;
+    bool stream = false;
+    bool budget = false;
+    size_t mem_limit = 0;
+    std::vector<std::string> dot_functions;
+    std::string profile_path;
+    const char* batch_source = nullptr;
+    const char* batch_out = nullptr;
+    const char* watch_dir = nullptr;
+    bool jsonl = false;
+    JsonlFraming jsonl_framing = JsonlFraming::Separator;
+    size_t threads = 1;
+    std::string cache_dir;
+    size_t cache_size = OutputCache::DEFAULT_MAX_BYTES;
+    bool cache_stats = false;
+    LowerOptions lower_options;
+    std::vector<const char*> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            opt_level = arg[2] - '0';
+        } else if (arg == "--time-passes") {
+            time_passes = true;
+        } else if (arg == "--branchless-select") {
+            lower_options.branchless_select = true;
+        } else if (arg == "--fuse-branch-cmp") {
+            lower_options.fuse_branch_cmp = fuse_branch_cmp = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "-o") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format == "text") {
+                output_format = OutputFormat::Text;
+            } else if (format == "lirb") {
+                output_format = OutputFormat::Lirb;
+            } else if (format == "json") {
+                output_format = OutputFormat::Json;
+            } else {
+                std::cerr << "Error: Unknown output format '" << format << "'\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--batch" || arg == "--out" || arg == "--watch") {
+            if (i + 1 == argc) {
+                std::cerr << "Error: " << arg << " needs an argument\n";
+                return 1;
+            }
+            (arg == "--batch" ? batch_source : arg == "--out" ? batch_out : watch_dir) = argv[++i];
+        } else if (arg.rfind("--dot=", 0) == 0) {
+            std::istringstream names(arg.substr(6));
+            for (std::string name; std::getline(names, name, ',');) {
+                if (!name.empty()) dot_functions.push_back(name);
+            }
+            if (dot_functions.empty()) {
+                std::cerr << "Error: --dot needs at least one function name\n";
+                return 1;
+            }
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            profile_path = arg.substr(10);
+        } else if (arg == "--jsonl" || arg == "--jsonl=records") {
+            jsonl = true;
+            jsonl_framing = arg == "--jsonl" ? JsonlFraming::Separator : JsonlFraming::Records;
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            cache_dir = arg.substr(12);
+        } else if (arg.rfind("--cache-size=", 0) == 0) {
+            if (!parse_count(arg, 13, cache_size)) {
+                std::cerr << "Error: Invalid cache size in " << arg << "\n";
+                return 1;
+            }
+        } else if (arg.rfind("--mem-limit=", 0) == 0) {
+            if (!parse_count(arg, 12, mem_limit)) {
+                std::cerr << "Error: Invalid memory limit in " << arg << "\n";
+                return 1;
+            }
+            budget = true;
+        } else if (arg == "--cache-stats") {
+            cache_stats = true;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parse_count(arg, 10, threads)) {
+                std::cerr << "Error: Invalid thread count in " << arg << "\n";
+                return 1;
+            }
+            threads = ThreadPool::resolve_threads(threads);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Error: Unknown option " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    const char* input_path = inputs.empty() ? nullptr : inputs[0];
+    // Several inputs are modules of one program
+    bool linking = inputs.size() > 1;
+    if (cache_stats) {
+        if (cache_dir.empty()) {
+            std::cerr << "Error: --cache-stats needs --cache-dir\n";
+            return 1;
+        }
+        try {
+            print_cache_stats(OutputCache::read_stats(cache_dir), cache_size, std::cout);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (budget && (stream || !dot_functions.empty() || !cache_dir.empty() || batch_source || batch_out ||
+                   watch_dir || jsonl || linking)) {
+        std::cerr << "Error: --mem-limit cannot be combined with --stream, --dot, --cache-dir, --batch, --watch,\n"
+                  << "--jsonl or several inputs\n";
         return 1;
     }
-    
-    // 1. Open and read the input file
-    std::ifstream input_file(argv[1]);
-    if (!input_file.is_open()) {
-        std::cerr << "Error: Could not open file " << argv[1] << "\n";
+    if (!cache_dir.empty() && (stream || !dot_functions.empty())) {
+        std::cerr << "Error: --cache-dir cannot be combined with --stream or --dot\n";
         return 1;
     }
-    
-    nlohmann::json j;
-    try {
-        j = nlohmann::json::parse(input_file);
-    } catch (nlohmann::json::parse_error& e) {
-        std::cerr << "Error: Failed to parse JSON.\n" << e.what() << std::endl;
+    // A hit skips the pipeline, so runs that check or time it bypass the cache
+    std::unique_ptr<OutputCache> cache;
+    if (!cache_dir.empty() && !verify && !time_passes) {
+        try {
+            cache = std::make_unique<OutputCache>(cache_dir, cache_size,
+                                                  describe_output(opt_level, lower_options, output_format));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    BatchOptions batch_options;
+    batch_options.lower = lower_options;
+    batch_options.opt_level = opt_level;
+    batch_options.fuse_branch_cmp = fuse_branch_cmp;
+    batch_options.verify = verify;
+    batch_options.time_passes = time_passes;
+    batch_options.threads = threads;
+    batch_options.format = output_format;
+    batch_options.cache = cache.get();
+    if (jsonl) {
+        if (linking) {
+            std::cerr << "Error: --jsonl reads a single file or stdin\n";
+            return 1;
+        }
+        if (batch_source || batch_out || watch_dir || stream || !dot_functions.empty() ||
+            !cache_dir.empty()) {
+            std::cerr << "Error: --jsonl cannot be combined with --batch, --watch, --stream, --dot or --cache-dir\n";
+            return 1;
+        }
+        if (output_format != OutputFormat::Text) {
+            std::cerr << "Error: --jsonl only writes text output\n";
+            return 1;
+        }
+        std::ifstream file;
+        if (input_path && std::string(input_path) != "-") {
+            file.open(input_path);
+            if (!file) {
+                std::cerr << "Error: Could not open file " << input_path << "\n";
+                return 1;
+            }
+        }
+        try {
+            LIR::LirEmitter emitter(STDOUT_FILENO);
+            size_t failed = run_jsonl(file.is_open() ? file : std::cin, emitter, batch_options, jsonl_framing);
+            emitter.flush();
+            return failed == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed to lower JSON lines.\n" << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (watch_dir) {
+        if (!batch_out || batch_source || input_path) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (stream || !dot_functions.empty() || !cache_dir.empty()) {
+            std::cerr << "Error: --watch cannot be combined with --stream, --dot or --cache-dir\n";
+            return 1;
+        }
+        try {
+            run_watch(watch_dir, batch_out, batch_options);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Watch failed.\n" << e.what() << std::endl;
+        }
+        return 1;
+    }
+    if (batch_source || batch_out) {
+        if (!batch_source || !batch_out || input_path) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (stream || !dot_functions.empty()) {
+            std::cerr << "Error: --batch cannot be combined with --stream or --dot\n";
+            return 1;
+        }
+        try {
+            return run_batch(collect_batch_inputs(batch_source), batch_out, batch_options) == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Batch failed.\n" << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!input_path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (linking && (stream || !cache_dir.empty())) {
+        std::cerr << "Error: several inputs cannot be combined with --stream or --cache-dir\n";
+        return 1;
+    }
+    if (stream && (output_format != OutputFormat::Text || opt_level > 1)) {
+        std::cerr << "Error: --stream only supports text output at -O0 or -O1\n";
         return 1;
     }
 
-    // 2. Parse the AST (using your ast.cpp function)
-    std::unique_ptr<AST::Program> ast_prog;
+    if (!profile_path.empty() && dot_functions.empty()) {
+        std::cerr << "Error: --profile is only used with --dot\n";
+        return 1;
+    }
+    if (stream && !dot_functions.empty()) {
+        std::cerr << "Error: --dot cannot be combined with --stream\n";
+        return 1;
+    }
+    if (!dot_functions.empty() && output_format != OutputFormat::Text) {
+        std::cerr << "Error: --dot prints Graphviz and cannot be combined with -o lirb or -o json\n";
+        return 1;
+    }
+
+    bool lir_input = ends_with(input_path, ".lir");
+    bool lirb_input = ends_with(input_path, ".lirb");
+    if (stream && (lir_input || lirb_input)) {
+        std::cerr << "Error: --stream only supports .astj input\n";
+        return 1;
+    }
+    if (budget && (lir_input || lirb_input || output_format != OutputFormat::Text)) {
+        std::cerr << "Error: --mem-limit only supports .astj input and text output\n";
+        return 1;
+    }
+
+    // A cached output is copied out as it is
+    std::string cache_key;
+    if (cache) {
+        try {
+            cache_key = cache->key_of(input_path);
+            if (cache->fetch(cache_key, STDOUT_FILENO)) return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // 1-3. LIR inputs are read as they are; ASTs are parsed and lowered
+    std::unique_ptr<LIR::Program> lir_prog;
+    if (linking) {
+        // Modules are lowered in parallel, each as it would be on its own
+        try {
+            ThreadPool pool(threads);
+            std::vector<std::string> names(inputs.begin(), inputs.end());
+            std::vector<LIR::Program> modules(names.size());
+            pool.parallel_for(names.size(), [&](size_t i, size_t) {
+                try {
+                    Lowerer lowerer(lower_options);
+                    modules[i] = std::move(*load_input(names[i], lowerer, pool));
+                    if (verify) LIR::verify(modules[i]);
+                } catch (const std::exception& e) {
+                    throw std::runtime_error(names[i] + ": " + e.what());
+                }
+            });
+            lir_prog = std::make_unique<LIR::Program>(LIR::link(std::move(modules), names));
+            if (verify) LIR::verify(*lir_prog);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed to link modules.\n" << e.what() << std::endl;
+            return 1;
+        }
+    } else if (lir_input || lirb_input) {
+        try {
+            lir_prog = std::make_unique<LIR::Program>(
+                lir_input ? LIR::read_lir_file(input_path) : LIR::LirbFile(input_path).read_program());
+            if (verify) LIR::verify(*lir_prog);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed to read LIR input.\n" << e.what() << std::endl;
+            return 1;
+        }
+    } else {
+        // 1. Open and read the input file
+        std::ifstream input_file(input_path);
+        if (!input_file.is_open()) {
+            std::cerr << "Error: Could not open file " << input_path << "\n";
+            return 1;
+        }
+
+        nlohmann::json j;
+        try {
+            j = nlohmann::json::parse(input_file);
+        } catch (nlohmann::json::parse_error& e) {
+            std::cerr << "Error: Failed to parse JSON.\n" << e.what() << std::endl;
+            return 1;
+        }
+
+        // Streaming mode does steps 2-5 one function at a time
+        if (stream) {
+            StreamOptions options;
+            options.lower = lower_options;
+            options.opt_level = opt_level;
+            options.fuse_branch_cmp = fuse_branch_cmp;
+            options.verify = verify;
+            options.time_passes = time_passes;
+            try {
+                LIR::LirEmitter emitter(STDOUT_FILENO);
+                lower_streaming(j, options, emitter);
+                emitter.flush();
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Failed during streaming lowering.\n" << e.what() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+        if (budget) {
+            BudgetOptions options;
+            options.lower = lower_options;
+            options.opt_level = opt_level;
+            options.fuse_branch_cmp = fuse_branch_cmp;
+            options.verify = verify;
+            options.time_passes = time_passes;
+            options.mem_limit = mem_limit;
+            try {
+                LIR::LirEmitter emitter(STDOUT_FILENO);
+                lower_within_budget(j, options, emitter);
+                emitter.flush();
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Failed during memory-limited lowering.\n" << e.what() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+
+        // 2. Parse the AST (using your ast.cpp function)
+        std::unique_ptr<AST::Program> ast_prog;
+        try {
+            ast_prog = buildProgram(j);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed to build AST from JSON.\n" << e.what() << std::endl;
+            return 1;
+        }
+
+        // 3. Lower the AST to LIR
+        try {
+            Lowerer lowerer(lower_options);
+            lir_prog = lowerer.lower(ast_prog.get());
+            if (verify) LIR::verify(*lir_prog);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed during lowering.\n" << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // 4. Optimize (nothing runs at -O0)
     try {
-        ast_prog = buildProgram(j);
+        LIR::PassManager pm = LIR::build_pipeline(opt_level, threads, fuse_branch_cmp);
+        pm.run(*lir_prog);
+        if (time_passes) pm.print_report(std::cerr);
+        if (verify) LIR::verify(*lir_prog);
     } catch (const std::exception& e) {
-        std::cerr << "Error: Failed to build AST from JSON.\n" << e.what() << std::endl;
+        std::cerr << "Error: Failed during optimization.\n" << e.what() << std::endl;
         return 1;
     }
-    
-    // 3. Lower the AST to LIR
-    std::unique_ptr<LIR::Program> lir_prog;
+
+    // 5a. Or print the CFGs asked for with --dot
+    if (!dot_functions.empty()) {
+        try {
+            LIR::BlockProfile profile;
+            if (!profile_path.empty()) profile = LIR::read_block_profile(profile_path);
+            std::string text;
+            for (const auto& name : dot_functions) {
+                auto fn = lir_prog->functions.find(name);
+                if (fn == lir_prog->functions.end()) throw std::runtime_error("no function named " + name);
+                // A function missing from the profile never ran
+                LIR::render_dot(fn->second, text, profile_path.empty() ? nullptr : &profile[name]);
+            }
+            LIR::write_all(STDOUT_FILENO, text);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Failed to export CFG.\n" << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // 5. Print the LIR program to standard out: the text of operator<< from
+    // lir.hpp written in large blocks, its lirb encoding or JSON. With a
+    // cache it is written to a new entry first and copied out from there.
+    std::string scratch_path;
+    int scratch_fd = -1;
     try {
-        Lowerer lowerer;
-        lir_prog = lowerer.lower(ast_prog.get());
+        if (cache) {
+            try {
+                scratch_fd = cache->create_scratch(scratch_path);
+            } catch (const std::exception&) {
+                // Written straight out, uncached
+            }
+        }
+        LIR::LirEmitter emitter(scratch_fd >= 0 ? scratch_fd : STDOUT_FILENO);
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1 && output_format == OutputFormat::Text) pool = std::make_unique<ThreadPool>(threads);
+        emit_program(*lir_prog, output_format, emitter, pool.get());
+        emitter.flush();
+        if (scratch_fd >= 0) {
+            if (::lseek(scratch_fd, 0, SEEK_SET) != 0) throw std::runtime_error("cannot rewind cache entry");
+            copy_to_end(scratch_fd, STDOUT_FILENO);
+            ::close(scratch_fd);
+            scratch_fd = -1;
+            cache->insert(cache_key, scratch_path);
+        }
     } catch (const std::exception& e) {
-        std::cerr << "Error: Failed during lowering.\n" << e.what() << std::endl;
+        if (scratch_fd >= 0) {
+            ::close(scratch_fd);
+            ::unlink(scratch_path.c_str());
+        }
+        std::cerr << "Error: Failed to write output.\n" << e.what() << std::endl;
         return 1;
     }
-    
-    // 4. Print the LIR program to standard out
-    // This uses the operator<< from lir.h
-    std::cout << *lir_prog;
-    
+
     return 0;
-}
\ No newline at end of file
+}
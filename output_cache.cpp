@@ -0,0 +1,346 @@
+#include "output_cache.hpp"
+#include "lir_emitter.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bumped when the layout of the cache directory changes
+constexpr const char* CACHE_FORMAT = "lower-cache 1";
+
+// Scratch files this old belong to a process that died while writing
+constexpr time_t STALE_SCRATCH_SECONDS = 24 * 60 * 60;
+
+// --- Hashing ---
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3_x64_128 (public domain, Austin Appleby) with both halves of
+// the state seeded, reading words in host byte order
+void murmur3_128(const char* data, size_t len, const uint64_t seed[2], uint64_t out[2]) {
+    constexpr uint64_t c1 = 0x87c37b91114253d5ULL;
+    constexpr uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed[0];
+    uint64_t h2 = seed[1];
+
+    size_t blocks = len / 16;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1, k2;
+        std::memcpy(&k1, data + i * 16, 8);
+        std::memcpy(&k2, data + i * 16 + 8, 8);
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const auto* tail = reinterpret_cast<const unsigned char*>(data + blocks * 16);
+    size_t rest = len & 15;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = rest; i > 8; --i) k2 ^= uint64_t(tail[i - 1]) << ((i - 9) * 8);
+    for (size_t i = std::min<size_t>(rest, 8); i > 0; --i) k1 ^= uint64_t(tail[i - 1]) << ((i - 1) * 8);
+    if (rest > 8) { k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2; }
+    if (rest > 0) { k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1; }
+
+    h1 ^= len; h2 ^= len;
+    h1 += h2; h2 += h1;
+    h1 = fmix(h1); h2 = fmix(h2);
+    h1 += h2; h2 += h1;
+    out[0] = h1;
+    out[1] = h2;
+}
+
+bool is_entry_name(const std::string& name) {
+    return name.size() == 32 && std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+// --- Shared counters ---
+
+// The stats file, locked for as long as this object lives
+class StatsFile {
+public:
+    explicit StatsFile(const std::string& dir) {
+        m_fd = ::open((dir + "/stats").c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) throw std::runtime_error("cache: cannot open " + dir + "/stats: " + std::strerror(errno));
+        while (::flock(m_fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                ::close(m_fd);
+                throw std::runtime_error(std::string("cache: cannot lock stats: ") + std::strerror(errno));
+            }
+        }
+    }
+    ~StatsFile() { ::close(m_fd); } // releases the lock
+    StatsFile(const StatsFile&) = delete;
+    StatsFile& operator=(const StatsFile&) = delete;
+
+    // Unknown lines are skipped, so a damaged file reads as zeros
+    CacheStats read() const {
+        std::string text;
+        char buf[512];
+        ssize_t n;
+        for (off_t offset = 0; (n = ::pread(m_fd, buf, sizeof(buf), offset)) > 0; offset += n) {
+            text.append(buf, static_cast<size_t>(n));
+        }
+        CacheStats stats;
+        std::istringstream lines(text);
+        std::string name;
+        uint64_t value;
+        while (lines >> name >> value) {
+            if (name == "hits") stats.hits = value;
+            else if (name == "misses") stats.misses = value;
+            else if (name == "stores") stats.stores = value;
+            else if (name == "evictions") stats.evictions = value;
+            else if (name == "bytes") stats.bytes = value;
+        }
+        return stats;
+    }
+
+    void write(const CacheStats& stats) {
+        std::string text = "hits " + std::to_string(stats.hits) + "\nmisses " + std::to_string(stats.misses) +
+                           "\nstores " + std::to_string(stats.stores) + "\nevictions " +
+                           std::to_string(stats.evictions) + "\nbytes " + std::to_string(stats.bytes) + "\n";
+        if (::ftruncate(m_fd, 0) != 0 || ::pwrite(m_fd, text.data(), text.size(), 0) < 0) {
+            throw std::runtime_error(std::string("cache: cannot write stats: ") + std::strerror(errno));
+        }
+    }
+
+private:
+    int m_fd;
+};
+
+} // namespace
+
+// --- OutputCache ---
+
+OutputCache::OutputCache(const std::string& dir, uint64_t max_bytes, const std::string& options)
+    : m_dir(dir), m_max_bytes(max_bytes) {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+    if (!fs::is_directory(m_dir, ec)) throw std::runtime_error("cache: cannot create directory " + m_dir);
+    // Fail now rather than on the first store
+    StatsFile check(m_dir);
+
+    // Rebuilding lower changes its size or modification time
+    struct stat exe;
+    if (::stat("/proc/self/exe", &exe) != 0) {
+        throw std::runtime_error(std::string("cache: cannot identify the executable: ") + std::strerror(errno));
+    }
+    std::string salt = std::string(CACHE_FORMAT) + "\n" + std::to_string(exe.st_size) + " " +
+                       std::to_string(exe.st_mtim.tv_sec) + "." + std::to_string(exe.st_mtim.tv_nsec) + "\n" +
+                       options;
+    const uint64_t zero[2] = {0, 0};
+    murmur3_128(salt.data(), salt.size(), zero, m_salt);
+}
+
+OutputCache::~OutputCache() {
+    if (m_hits == 0 && m_misses == 0) return;
+    try {
+        StatsFile file(m_dir);
+        CacheStats stats = file.read();
+        stats.hits += m_hits;
+        stats.misses += m_misses;
+        file.write(stats);
+    } catch (const std::exception&) {
+        // Counters are best effort
+    }
+}
+
+std::string OutputCache::key_of(const std::string& path) const {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    ::close(fd);
+    if (map == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+
+    uint64_t hash[2];
+    murmur3_128(static_cast<const char*>(map), size, m_salt, hash);
+    if (map) ::munmap(map, size);
+
+    static const char hex[] = "0123456789abcdef";
+    std::string key(32, '0');
+    for (int i = 0; i < 32; ++i) key[i] = hex[(hash[i / 16] >> (60 - 4 * (i % 16))) & 0xf];
+    return key;
+}
+
+bool OutputCache::fetch(const std::string& key, int fd) {
+    int entry = ::open((m_dir + "/" + key).c_str(), O_RDONLY);
+    if (entry < 0) {
+        ++m_misses;
+        return false;
+    }
+    // Recently used entries are evicted last
+    ::futimens(entry, nullptr);
+    try {
+        copy_to_end(entry, fd);
+    } catch (...) {
+        ::close(entry);
+        throw;
+    }
+    ::close(entry);
+    ++m_hits;
+    return true;
+}
+
+int OutputCache::create_scratch(std::string& path) {
+    path = m_dir + "/tmp." + std::to_string(::getpid()) + "." + std::to_string(m_scratch_count++);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("cache: cannot create " + path + ": " + std::strerror(errno));
+    return fd;
+}
+
+void OutputCache::insert(const std::string& key, const std::string& path) {
+    try {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) return;
+        std::string entry = m_dir + "/" + key;
+        // Locked before looking at the old entry, so that stores of one key
+        // each take back exactly the size they replace
+        StatsFile file(m_dir);
+        struct stat old;
+        uint64_t replaced = ::stat(entry.c_str(), &old) == 0 ? static_cast<uint64_t>(old.st_size) : 0;
+        // Readers see the old entry, the new one or none, never a partial one
+        if (::rename(path.c_str(), entry.c_str()) != 0) {
+            ::unlink(path.c_str());
+            return;
+        }
+        CacheStats stats = file.read();
+        ++stats.stores;
+        stats.bytes = stats.bytes - std::min(stats.bytes, replaced) + static_cast<uint64_t>(st.st_size);
+        if (stats.bytes > m_max_bytes) stats.bytes = evict(stats);
+        file.write(stats);
+    } catch (const std::exception&) {
+        // Only an accelerator
+        ::unlink(path.c_str());
+    }
+}
+
+void OutputCache::store(const std::string& key, const std::string& path) {
+    int in = ::open(path.c_str(), O_RDONLY);
+    if (in < 0) return;
+    std::string scratch;
+    try {
+        int out = create_scratch(scratch);
+        try {
+            copy_to_end(in, out);
+        } catch (...) {
+            ::close(out);
+            throw;
+        }
+        ::close(out);
+    } catch (const std::exception&) {
+        ::close(in);
+        if (!scratch.empty()) ::unlink(scratch.c_str());
+        return;
+    }
+    ::close(in);
+    insert(key, scratch);
+}
+
+uint64_t OutputCache::evict(CacheStats& stats) {
+    struct Entry {
+        struct timespec used;
+        uint64_t size;
+        std::string path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    time_t now = std::time(nullptr);
+    for (const auto& item : fs::directory_iterator(m_dir)) {
+        std::string name = item.path().filename().string();
+        struct stat st;
+        if (::stat(item.path().c_str(), &st) != 0) continue;
+        if (name.rfind("tmp.", 0) == 0) {
+            if (now - st.st_mtim.tv_sec > STALE_SCRATCH_SECONDS) ::unlink(item.path().c_str());
+            continue;
+        }
+        if (!is_entry_name(name)) continue;
+        entries.push_back(Entry{st.st_mtim, static_cast<uint64_t>(st.st_size), item.path().string()});
+        total += static_cast<uint64_t>(st.st_size);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.used.tv_sec != b.used.tv_sec) return a.used.tv_sec < b.used.tv_sec;
+        return a.used.tv_nsec < b.used.tv_nsec;
+    });
+
+    // Down to 90% of the limit, so the next stores do not all scan again
+    uint64_t target = m_max_bytes - m_max_bytes / 10;
+    for (const auto& entry : entries) {
+        if (total <= target) break;
+        if (::unlink(entry.path.c_str()) == 0) {
+            total -= entry.size;
+            ++stats.evictions;
+        }
+    }
+    return total;
+}
+
+CacheStats OutputCache::read_stats(const std::string& dir) {
+    return StatsFile(dir).read();
+}
+
+// --- Helpers ---
+
+void copy_to_end(int in_fd, int out_fd) {
+    // The kernel copies without a round trip through user space when it can
+    while (true) {
+        ssize_t n = ::sendfile(out_fd, in_fd, nullptr, 1 << 30);
+        if (n > 0) continue;
+        if (n == 0) return;
+        if (errno == EINTR) continue;
+        if (errno == EINVAL || errno == ENOSYS) break;
+        throw std::runtime_error(std::string("copy failed: ") + std::strerror(errno));
+    }
+    std::vector<char> buf(1 << 16);
+    while (true) {
+        ssize_t n = ::read(in_fd, buf.data(), buf.size());
+        if (n == 0) return;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("copy failed: ") + std::strerror(errno));
+        }
+        LIR::write_all(out_fd, std::string_view(buf.data(), static_cast<size_t>(n)));
+    }
+}
+
+void print_cache_stats(const CacheStats& stats, uint64_t max_bytes, std::ostream& out) {
+    uint64_t lookups = stats.hits + stats.misses;
+    out << "hits       " << stats.hits << "\n"
+        << "misses     " << stats.misses << "\n";
+    if (lookups > 0) {
+        out << "hit rate   " << (stats.hits * 1000 / lookups) / 10.0 << "%\n";
+    }
+    out << "stores     " << stats.stores << "\n"
+        << "evictions  " << stats.evictions << "\n"
+        << "size       " << stats.bytes << " of " << max_bytes << " bytes\n";
+}
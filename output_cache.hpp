@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Content-addressed cache of lowered output (--cache-dir). Builds regenerate
+// the same inputs byte for byte, so the output of an input is filed under a
+// key hashed from its bytes, the identity of the running executable (a
+// rebuilt lower never sees its predecessor's entries) and a description of
+// the options that shape the output. A hit costs hashing the input and
+// copying the entry; nothing is parsed. Because a hit also skips --verify
+// and --time-passes, main does not open the cache for runs that ask for them.
+//
+// Layout of the cache directory:
+//   <32 hex digits>   one entry: the output exactly as written
+//   tmp.<pid>.<n>     an entry being written; renamed into place when done
+//   stats             hit/miss counters and the total entry size, updated
+//                     under flock() so concurrent processes can share a cache
+//
+// Entries are evicted least recently used first (a hit refreshes an entry's
+// modification time) once their total size exceeds the limit. The key hash
+// is MurmurHash3 x64/128: fast, and collisions need deliberately crafted
+// inputs, which a local build cache does not have to defend against.
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0;
+    uint64_t bytes = 0;
+};
+
+class OutputCache {
+public:
+    static constexpr uint64_t DEFAULT_MAX_BYTES = uint64_t(512) << 20;
+
+    // Opens (creating it if needed) the cache in `dir`. `options` describes
+    // everything besides the input that changes the output. Throws
+    // std::runtime_error if the directory cannot be used.
+    OutputCache(const std::string& dir, uint64_t max_bytes, const std::string& options);
+    // Adds this process's hits and misses to the shared counters
+    ~OutputCache();
+    OutputCache(const OutputCache&) = delete;
+    OutputCache& operator=(const OutputCache&) = delete;
+
+    // The key of the input file at `path`. Throws std::runtime_error if it
+    // cannot be read.
+    std::string key_of(const std::string& path) const;
+
+    // Copies the output filed under `key` to `fd` and counts a hit, or counts
+    // a miss and returns false. Errors writing to `fd` throw.
+    bool fetch(const std::string& key, int fd);
+
+    // Creates a file for an entry in the making and returns its descriptor,
+    // open for reading and writing; `path` is set to its name. Throws
+    // std::runtime_error on failure.
+    int create_scratch(std::string& path);
+    // Files the finished scratch file at `path` under `key`. The cache is
+    // only an accelerator, so failures here are ignored.
+    void insert(const std::string& key, const std::string& path);
+    // Files a copy of the file at `path` under `key`; failures are ignored.
+    void store(const std::string& key, const std::string& path);
+
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+
+    // Reads the shared counters of the cache in `dir`
+    static CacheStats read_stats(const std::string& dir);
+
+private:
+    // Evicts least recently used entries until they fit the limit again;
+    // returns the size left. Called with the stats lock held.
+    uint64_t evict(CacheStats& stats);
+
+    std::string m_dir;
+    uint64_t m_max_bytes;
+    uint64_t m_salt[2];
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_scratch_count{0};
+};
+
+// Copies `in_fd` from its current offset to its end into `out_fd`. Throws
+// std::runtime_error on failure.
+void copy_to_end(int in_fd, int out_fd);
+
+// Prints the counters of `stats` as `lower --cache-stats` shows them
+void print_cache_stats(const CacheStats& stats, uint64_t max_bytes, std::ostream& out);
@@ -0,0 +1,317 @@
+#include "pass_manager.hpp"
+#include "lir_passes.hpp"
+#include "lir_utils.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace LIR {
+
+// --- AnalysisManager ---
+
+void AnalysisManager::prepare(const Program& prog) {
+    for (const auto& [name, fn] : prog.functions) {
+        m_cache[name];
+    }
+}
+
+void AnalysisManager::invalidate(const FuncId& fn, bool cfg_preserved) {
+    auto it = m_cache.find(fn);
+    if (it == m_cache.end()) return;
+    // Only the function's own slot is touched; see prepare()
+    if (!cfg_preserved) {
+        it->second.clear();
+        return;
+    }
+    for (auto slot = it->second.begin(); slot != it->second.end(); ) {
+        if (slot->second.cfg_only) ++slot; else slot = it->second.erase(slot);
+    }
+}
+
+void AnalysisManager::invalidate_all() {
+    m_cache.clear();
+}
+
+// --- PassManager ---
+
+PassManager::PassManager(size_t threads)
+    : m_owned_pool(std::make_unique<ThreadPool>(threads)), m_pool(m_owned_pool.get()) {
+    for (size_t w = 0; w < m_pool->size(); ++w) {
+        m_arenas.push_back(std::make_unique<ScratchArena>());
+    }
+}
+
+PassManager::PassManager(ThreadPool& pool) : m_pool(&pool) {
+    for (size_t w = 0; w < m_pool->size(); ++w) {
+        m_arenas.push_back(std::make_unique<ScratchArena>());
+    }
+}
+
+void PassManager::add(std::unique_ptr<FunctionPass> pass) {
+    Step step;
+    step.fn_passes.push_back(std::move(pass));
+    m_steps.push_back(std::move(step));
+}
+
+void PassManager::add(std::unique_ptr<ModulePass> pass) {
+    Step step;
+    step.module_pass = std::move(pass);
+    m_steps.push_back(std::move(step));
+}
+
+void PassManager::add_fixed_point(std::vector<std::unique_ptr<FunctionPass>> group, int max_iters) {
+    Step step;
+    step.fn_passes = std::move(group);
+    step.max_iters = max_iters;
+    m_steps.push_back(std::move(step));
+}
+
+PassManager::PassStats& PassManager::stats_for(const char* name) {
+    for (auto& [pname, stats] : m_stats) {
+        if (pname == name) return stats;
+    }
+    m_stats.push_back({name, PassStats{}});
+    return m_stats.back().second;
+}
+
+void PassManager::run(Program& prog) {
+    auto wall_start = std::chrono::steady_clock::now();
+    // Anything cached by an earlier run describes another program (or one
+    // that was abandoned halfway), maybe with the same function names
+    m_am.invalidate_all();
+    for (auto& step : m_steps) {
+        m_am.prepare(prog);
+        if (step.module_pass) {
+            // Module passes are barriers: they see the whole program, alone
+            auto& stats = stats_for(step.module_pass->name());
+            long long before = count_insts(prog);
+            auto start = std::chrono::steady_clock::now();
+            bool changed = step.module_pass->run(prog, m_am);
+            stats.time += std::chrono::steady_clock::now() - start;
+            stats.runs++;
+            stats.insts_before += before;
+            stats.insts_after += count_insts(prog);
+            if (changed) {
+                stats.changed++;
+                m_am.invalidate_all();
+            }
+        } else {
+            run_function_step(step, prog);
+        }
+    }
+    m_wall += std::chrono::steady_clock::now() - wall_start;
+}
+
+void PassManager::run_function_step(Step& step, Program& prog) {
+    // Hand out the biggest functions first so one large function does not
+    // start last and leave the other workers idle.
+    std::vector<Function*> fns;
+    for (auto& [fname, fn] : prog.functions) {
+        fns.push_back(&fn);
+    }
+    std::vector<size_t> sizes;
+    for (auto* fn : fns) sizes.push_back(count_insts(*fn));
+    std::vector<size_t> order(fns.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    // Each function's stats are kept separately and merged in name order
+    // afterwards, so the report does not depend on scheduling.
+    std::vector<std::vector<PassStats>> fn_stats(fns.size(), std::vector<PassStats>(step.fn_passes.size()));
+    m_pool->parallel_for(order.size(), [&](size_t i, size_t worker) {
+        size_t idx = order[i];
+        ScratchArena& arena = *m_arenas[worker];
+        PassContext ctx{prog, m_am, arena.resource()};
+        run_on_function(step, *fns[idx], ctx, fn_stats[idx]);
+        arena.reset();
+    });
+
+    for (auto& per_fn : fn_stats) {
+        for (size_t p = 0; p < step.fn_passes.size(); ++p) {
+            auto& total = stats_for(step.fn_passes[p]->name());
+            const auto& s = per_fn[p];
+            total.runs += s.runs;
+            total.changed += s.changed;
+            total.insts_before += s.insts_before;
+            total.insts_after += s.insts_after;
+            total.time += s.time;
+        }
+    }
+}
+
+void PassManager::run_on_function(Step& step, Function& fn, PassContext& ctx, std::vector<PassStats>& stats) {
+    // A single pass runs once; a group repeats until nothing changes
+    for (int iter = 0; iter < step.max_iters; ++iter) {
+        bool any_changed = false;
+        for (size_t p = 0; p < step.fn_passes.size(); ++p) {
+            auto& pass = step.fn_passes[p];
+            long long before = count_insts(fn);
+            auto start = std::chrono::steady_clock::now();
+            bool changed = pass->run(fn, ctx);
+            stats[p].time += std::chrono::steady_clock::now() - start;
+            stats[p].runs++;
+            stats[p].insts_before += before;
+            stats[p].insts_after += count_insts(fn);
+            if (changed) {
+                stats[p].changed++;
+                ctx.am.invalidate(fn.name, pass->preserves_cfg());
+                any_changed = true;
+            }
+        }
+        if (!any_changed) break;
+    }
+}
+
+void PassManager::print_report(std::ostream& os) const { print_report(os, {this}); }
+
+void PassManager::print_report(std::ostream& os, const std::vector<const PassManager*>& pms) {
+    if (pms.empty()) return;
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+
+    // Rows of the same pass or counter are added up, in first-run order
+    std::vector<std::pair<std::string, PassStats>> merged;
+    std::vector<std::pair<std::string, size_t>> counters;
+    std::chrono::steady_clock::duration wall{};
+    for (const PassManager* pm : pms) {
+        wall += pm->m_wall;
+        for (const auto& [name, stats] : pm->m_stats) {
+            auto it = std::find_if(merged.begin(), merged.end(), [&](const auto& row) { return row.first == name; });
+            if (it == merged.end()) it = merged.insert(merged.end(), {name, PassStats{}});
+            it->second.runs += stats.runs;
+            it->second.changed += stats.changed;
+            it->second.insts_before += stats.insts_before;
+            it->second.insts_after += stats.insts_after;
+            it->second.time += stats.time;
+        }
+        for (const auto& step : pm->m_steps) {
+            for (const auto& pass : step.fn_passes) {
+                for (const auto& [counter, count] : pass->counters()) {
+                    std::string key = std::string(pass->name()) + " - " + counter;
+                    auto it = std::find_if(counters.begin(), counters.end(),
+                                           [&](const auto& row) { return row.first == key; });
+                    if (it == counters.end()) it = counters.insert(counters.end(), {key, 0});
+                    it->second += count;
+                }
+            }
+        }
+    }
+
+    os << "===-------------------------------------------------------------------===\n"
+       << "                        Pass execution report\n"
+       << "===-------------------------------------------------------------------===\n";
+    os << std::setw(10) << "Time(ms)" << std::setw(7) << "Runs" << std::setw(9) << "Changed"
+       << std::setw(15) << "Insts-before" << std::setw(14) << "Insts-after"
+       << std::setw(8) << "Delta" << "  Pass\n";
+
+    double total_ms = 0;
+    long long total_delta = 0;
+    for (const auto& [name, stats] : merged) {
+        long long delta = stats.insts_after - stats.insts_before;
+        total_ms += ms(stats.time);
+        total_delta += delta;
+        os << std::fixed << std::setprecision(3)
+           << std::setw(10) << ms(stats.time) << std::setw(7) << stats.runs
+           << std::setw(9) << stats.changed << std::setw(15) << stats.insts_before
+           << std::setw(14) << stats.insts_after << std::setw(8) << delta
+           << "  " << name << "\n";
+    }
+    os << std::setw(10) << total_ms << std::setw(7) << "" << std::setw(9) << ""
+       << std::setw(15) << "" << std::setw(14) << "" << std::setw(8) << total_delta
+       << "  Total\n";
+    os << std::setw(10) << ms(wall) << "  Wall time with " << pms.front()->m_pool->size() << " thread(s)\n";
+    os.unsetf(std::ios::fixed);
+
+    // Pass counters that fired at least once, LLVM -stats style
+    std::vector<std::string> rows;
+    for (const auto& [key, count] : counters) {
+        if (count == 0) continue;
+        std::ostringstream row;
+        row << std::setw(10) << count << "  " << key << "\n";
+        rows.push_back(row.str());
+    }
+    if (rows.empty()) return;
+    os << "===-------------------------------------------------------------------===\n"
+       << "                          Statistics Collected\n"
+       << "===-------------------------------------------------------------------===\n";
+    for (const auto& row : rows) os << row;
+}
+
+// --- Pipelines ---
+
+namespace {
+
+// Which part of a pipeline add_pipeline() appends. The module passes all
+// come after the function passes, so the parts can run separately.
+enum class PipelinePart { All, Functions, Module };
+
+void add_pipeline(PassManager& pm, int opt_level, bool fuse_branch_cmp, PipelinePart part = PipelinePart::All) {
+    bool functions = part != PipelinePart::Module;
+    bool module = part != PipelinePart::Functions;
+    if (opt_level <= 0) {
+        if (fuse_branch_cmp && functions) {
+            pm.add(create_fuse_branch_cmp_pass());
+            pm.add(create_prune_locals_pass());
+        }
+        return;
+    }
+
+    if (functions) {
+        if (opt_level >= 2) {
+            pm.add(create_sccp_pass());
+            pm.add(create_gvn_pass());
+        }
+
+        // Cleanup passes feed each other (folding a branch makes blocks
+        // unreachable, which leaves more dead code), so iterate them together.
+        std::vector<std::unique_ptr<FunctionPass>> cleanup;
+        cleanup.push_back(create_const_fold_pass());
+        if (opt_level >= 2) {
+            cleanup.push_back(create_peephole_pass());
+            cleanup.push_back(create_copy_prop_pass());
+        }
+        cleanup.push_back(create_jump_threading_pass());
+        cleanup.push_back(create_unreachable_blocks_pass());
+        cleanup.push_back(create_merge_blocks_pass());
+        cleanup.push_back(create_dce_pass());
+        pm.add_fixed_point(std::move(cleanup));
+
+        if (fuse_branch_cmp) {
+            pm.add(create_fuse_branch_cmp_pass());
+        }
+        pm.add(create_prune_locals_pass());
+    }
+    // --mem-limit (spill.cpp) applies dead-externs in its two steps instead;
+    // a new module pass needs a counterpart there
+    if (module && opt_level >= 2) {
+        pm.add(create_dead_externs_pass());
+    }
+}
+
+} // namespace
+
+PassManager build_pipeline(int opt_level, size_t threads, bool fuse_branch_cmp) {
+    PassManager pm(threads);
+    add_pipeline(pm, opt_level, fuse_branch_cmp);
+    return pm;
+}
+
+PassManager build_pipeline(int opt_level, ThreadPool& pool, bool fuse_branch_cmp) {
+    PassManager pm(pool);
+    add_pipeline(pm, opt_level, fuse_branch_cmp);
+    return pm;
+}
+
+PassManager build_function_pipeline(int opt_level, size_t threads, bool fuse_branch_cmp) {
+    PassManager pm(threads);
+    add_pipeline(pm, opt_level, fuse_branch_cmp, PipelinePart::Functions);
+    return pm;
+}
+
+PassManager build_module_pipeline(int opt_level) {
+    PassManager pm;
+    add_pipeline(pm, opt_level, false, PipelinePart::Module);
+    return pm;
+}
+
+} // namespace LIR
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "lir.hpp"
+#include "lir_analysis.hpp"
+#include "thread_pool.hpp"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+namespace LIR {
+
+// --- Analysis Cache ---
+
+// Caches analyses per function. Passes ask for an analysis with get<A>(fn);
+// it is computed on first use and kept until a pass reports that it changed
+// the function, at which point the pass manager invalidates it.
+//
+// Function passes run concurrently on different functions, so the per-function
+// slots are created up front by prepare() and get()/invalidate() only ever
+// touch the slot of the function being processed.
+class AnalysisManager {
+public:
+    // Create the (empty) cache slot of every function in `prog`.
+    void prepare(const Program& prog);
+
+    template <typename A>
+    const A& get(const Function& fn) {
+        auto& slot = m_cache.at(fn.name)[std::type_index(typeid(A))];
+        if (!slot.value) {
+            slot.value = std::make_shared<A>(A::compute(fn));
+            slot.cfg_only = A::cfg_only;
+        }
+        return *static_cast<const A*>(slot.value.get());
+    }
+
+    // Drop the cached analyses of `fn`. If `cfg_preserved`, analyses that
+    // only depend on the block graph are kept.
+    void invalidate(const FuncId& fn, bool cfg_preserved = false);
+    void invalidate_all();
+
+private:
+    struct Slot {
+        std::shared_ptr<void> value;
+        bool cfg_only = false;
+    };
+    std::map<FuncId, std::map<std::type_index, Slot>> m_cache;
+};
+
+// --- Passes ---
+
+// What a function pass gets to work with besides the function itself.
+struct PassContext {
+    // Module-level data (structs, externs, funptrs) is read-only while function
+    // passes run. Other functions' bodies may be rewritten concurrently and
+    // must not be read.
+    const Program& prog;
+    AnalysisManager& am;
+    // Per-thread arena for temporaries; reset after each function
+    std::pmr::memory_resource* scratch;
+};
+
+// A transformation of a single function. run() is called concurrently for
+// different functions, so passes keep their per-run state local.
+class FunctionPass {
+public:
+    virtual ~FunctionPass() = default;
+    virtual const char* name() const = 0;
+    // Returns true if `fn` was changed
+    virtual bool run(Function& fn, PassContext& ctx) = 0;
+    // True if the pass never adds, removes or retargets blocks
+    virtual bool preserves_cfg() const { return false; }
+    // Named event counts accumulated over all runs (e.g. how often each
+    // rewrite rule fired), listed under the --time-passes report
+    virtual std::vector<std::pair<std::string, size_t>> counters() const { return {}; }
+};
+
+// A transformation over the whole program (e.g. removing unused externs).
+class ModulePass {
+public:
+    virtual ~ModulePass() = default;
+    virtual const char* name() const = 0;
+    // Returns true if `prog` was changed
+    virtual bool run(Program& prog, AnalysisManager& am) = 0;
+};
+
+// --- Pass Manager ---
+
+class PassManager {
+public:
+    // Function passes run on up to `threads` functions at once; module
+    // passes run alone, between them.
+    explicit PassManager(size_t threads = 1);
+    // Runs function passes on `pool`, which may be shared with other work
+    // and other pass managers and must outlive this one.
+    explicit PassManager(ThreadPool& pool);
+
+    // Append a function pass, run once over every function.
+    void add(std::unique_ptr<FunctionPass> pass);
+    // Append a module pass.
+    void add(std::unique_ptr<ModulePass> pass);
+    // Append a group of function passes that is re-run on each function until
+    // none of them changes it (or `max_iters` rounds have run).
+    void add_fixed_point(std::vector<std::unique_ptr<FunctionPass>> group, int max_iters = 8);
+
+    void run(Program& prog);
+
+    // Per-pass wall time and instruction counts, accumulated over all runs
+    void print_report(std::ostream& os) const;
+    // One report adding up the runs of `pms`, which build the same pipeline
+    // (e.g. one per batch worker); their wall times are summed too
+    static void print_report(std::ostream& os, const std::vector<const PassManager*>& pms);
+
+    bool empty() const { return m_steps.empty(); }
+
+private:
+    struct Step {
+        std::vector<std::unique_ptr<FunctionPass>> fn_passes; // one pass, or a fixed-point group
+        std::unique_ptr<ModulePass> module_pass;
+        int max_iters = 1;
+    };
+
+    struct PassStats {
+        size_t runs = 0;
+        size_t changed = 0;
+        long long insts_before = 0;
+        long long insts_after = 0;
+        std::chrono::steady_clock::duration time{};
+    };
+
+    void run_function_step(Step& step, Program& prog);
+    void run_on_function(Step& step, Function& fn, PassContext& ctx, std::vector<PassStats>& stats);
+    PassStats& stats_for(const char* name);
+
+    std::vector<Step> m_steps;
+    AnalysisManager m_am;
+    std::unique_ptr<ThreadPool> m_owned_pool;
+    ThreadPool* m_pool;
+    std::vector<std::unique_ptr<ScratchArena>> m_arenas; // one per worker
+    std::chrono::steady_clock::duration m_wall{};
+    // Report rows in first-run order
+    std::vector<std::pair<std::string, PassStats>> m_stats;
+};
+
+// The standard pipelines for -O0, -O1 and -O2. -O0 is empty so the output
+// matches the reference lowering exactly. `fuse_branch_cmp` appends the
+// fuse-branch-cmp pass (at any level) once the other passes are done.
+PassManager build_pipeline(int opt_level, size_t threads = 1, bool fuse_branch_cmp = false);
+// The same on a shared pool
+PassManager build_pipeline(int opt_level, ThreadPool& pool, bool fuse_branch_cmp = false);
+// build_pipeline() in two parts, for callers that optimize functions one at
+// a time: its function passes, which only look at the function they run on,
+// and the module passes that follow them on the whole program.
+PassManager build_function_pipeline(int opt_level, size_t threads = 1, bool fuse_branch_cmp = false);
+PassManager build_module_pipeline(int opt_level);
+
+} // namespace LIR
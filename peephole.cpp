@@ -0,0 +1,280 @@
+#include "lir_passes.hpp"
+#include "lir_utils.hpp"
+#include <array>
+#include <atomic>
+#include <set>
+#include <type_traits>
+
+// Peephole simplification over single instructions and short def chains
+// within a basic block.
+//
+// The rules are a table: each names the instruction kind it applies to and a
+// rewrite that either returns the replacement instruction or nothing. Rules
+// see the function's constants and, through Matcher::producer(), the
+// instruction in the same block that computed an operand, as long as that
+// instruction's own operands have not been reassigned since. The pass keeps a
+// counter per rule; --time-passes prints them.
+
+namespace LIR {
+
+namespace {
+
+class Matcher {
+public:
+    Matcher(const std::map<VarId, int>& constants, std::set<int>& needed)
+        : m_constants(constants), m_needed(needed) {}
+
+    std::optional<int> constant(const VarId& v) const {
+        auto it = m_constants.find(v);
+        if (it == m_constants.end()) return std::nullopt;
+        return it->second;
+    }
+    bool is(const VarId& v, int n) const { return constant(v) == n; }
+
+    // `_const_<n>`, created at the end of the pass
+    VarId make_const(int n) {
+        m_needed.insert(n);
+        return const_name(n);
+    }
+
+    // Start matching in `bb`; `last_def` maps the variables assigned so far
+    // to the position of their latest assignment
+    void reset(const BasicBlock& bb, const std::map<VarId, size_t>& last_def) {
+        m_bb = &bb;
+        m_last_def = &last_def;
+    }
+
+    // The instruction in this block that last assigned `v`, if reading its
+    // operands here would still give the values it read
+    const Inst* producer(const VarId& v) const {
+        auto it = m_last_def->find(v);
+        if (it == m_last_def->end()) return nullptr;
+        size_t at = it->second;
+        const Inst* inst = &m_bb->insts[at];
+        bool stale = false;
+        for_each_use(*inst, [&](const VarId& u) {
+            auto d = m_last_def->find(u);
+            if (d != m_last_def->end() && d->second >= at) stale = true;
+        });
+        return stale ? nullptr : inst;
+    }
+
+private:
+    const std::map<VarId, int>& m_constants;
+    std::set<int>& m_needed;
+    const BasicBlock* m_bb = nullptr;
+    const std::map<VarId, size_t>* m_last_def = nullptr;
+};
+
+template <typename T>
+const T* produced_as(const Matcher& m, const VarId& v) {
+    const Inst* inst = m.producer(v);
+    return inst ? std::get_if<T>(inst) : nullptr;
+}
+
+RelOp negate(RelOp rop) {
+    switch (rop) {
+        case RelOp::Eq:    return RelOp::NotEq;
+        case RelOp::NotEq: return RelOp::Eq;
+        case RelOp::Lt:    return RelOp::Gte;
+        case RelOp::Lte:   return RelOp::Gt;
+        case RelOp::Gt:    return RelOp::Lte;
+        case RelOp::Gte:   return RelOp::Lt;
+    }
+    return rop;
+}
+
+// `left aop right` as `base + offset` when one side is a constant
+std::optional<std::pair<VarId, int>> as_offset(const Arith& arith, const Matcher& m) {
+    if (arith.aop == ArithOp::Add) {
+        if (auto c = m.constant(arith.right)) return std::make_pair(arith.left, *c);
+        if (auto c = m.constant(arith.left)) return std::make_pair(arith.right, *c);
+    } else if (arith.aop == ArithOp::Sub) {
+        auto c = m.constant(arith.right);
+        if (!c) return std::nullopt;
+        if (auto neg = fold_arith(ArithOp::Sub, 0, *c)) return std::make_pair(arith.left, *neg);
+    }
+    return std::nullopt;
+}
+
+// --- Rules ---
+
+using Rewrite = std::optional<Inst> (*)(const Inst&, Matcher&);
+
+struct Rule {
+    const char* name;
+    size_t kind; // Inst::index() of the instructions it applies to
+    Rewrite rewrite;
+};
+
+template <typename T, size_t I = 0>
+constexpr size_t kind_of() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<I, Inst>, T>) return I;
+    else return kind_of<T, I + 1>();
+}
+
+const std::array<Rule, 12> RULES{{
+    // x + 0, 0 + x  =>  x
+    {"add-zero", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Add) return std::nullopt;
+        if (m.is(a.right, 0)) return Copy{a.lhs, a.left};
+        if (m.is(a.left, 0)) return Copy{a.lhs, a.right};
+        return std::nullopt;
+    }},
+    // x - 0  =>  x
+    {"sub-zero", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Sub || !m.is(a.right, 0)) return std::nullopt;
+        return Copy{a.lhs, a.left};
+    }},
+    // x - x  =>  0
+    {"sub-self", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Sub || a.left != a.right) return std::nullopt;
+        return Copy{a.lhs, m.make_const(0)};
+    }},
+    // x * 1, 1 * x, x / 1  =>  x
+    {"mul-one", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if ((a.aop == ArithOp::Mul || a.aop == ArithOp::Div) && m.is(a.right, 1)) return Copy{a.lhs, a.left};
+        if (a.aop == ArithOp::Mul && m.is(a.left, 1)) return Copy{a.lhs, a.right};
+        return std::nullopt;
+    }},
+    // x * 0, 0 * x  =>  0
+    {"mul-zero", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Mul || !(m.is(a.left, 0) || m.is(a.right, 0))) return std::nullopt;
+        return Copy{a.lhs, m.make_const(0)};
+    }},
+    // 0 - (0 - x)  =>  x; exact because sub wraps: 0 - INT_MIN is INT_MIN
+    {"neg-neg", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Sub || !m.is(a.left, 0)) return std::nullopt;
+        auto* inner = produced_as<Arith>(m, a.right);
+        if (!inner || inner->aop != ArithOp::Sub || !m.is(inner->left, 0)) return std::nullopt;
+        return Copy{a.lhs, inner->right};
+    }},
+    // (x ± c1) ± c2  =>  x + (±c1 ± c2); exact because add and sub wrap (see
+    // InstInfo::can_trap): for x = INT_MAX, (x + 1) - 1 is still x
+    {"reassoc-add", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        auto outer = as_offset(a, m);
+        if (!outer) return std::nullopt;
+        auto* inner_inst = produced_as<Arith>(m, outer->first);
+        if (!inner_inst) return std::nullopt;
+        auto inner = as_offset(*inner_inst, m);
+        if (!inner) return std::nullopt;
+        auto sum = fold_arith(ArithOp::Add, inner->second, outer->second);
+        if (!sum) return std::nullopt;
+        return Arith{a.lhs, ArithOp::Add, inner->first, m.make_const(*sum)};
+    }},
+    // (x * c1) * c2  =>  x * (c1 * c2); exact because mul wraps: for
+    // x = INT_MIN, (x * -1) * -1 is still x
+    {"reassoc-mul", kind_of<Arith>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& a = std::get<Arith>(inst);
+        if (a.aop != ArithOp::Mul) return std::nullopt;
+        auto c2 = m.constant(a.right);
+        const VarId* x = &a.left;
+        if (!c2) { c2 = m.constant(a.left); x = &a.right; }
+        if (!c2) return std::nullopt;
+        auto* inner = produced_as<Arith>(m, *x);
+        if (!inner || inner->aop != ArithOp::Mul) return std::nullopt;
+        auto c1 = m.constant(inner->right);
+        const VarId* y = &inner->left;
+        if (!c1) { c1 = m.constant(inner->left); y = &inner->right; }
+        if (!c1) return std::nullopt;
+        auto product = fold_arith(ArithOp::Mul, *c1, *c2);
+        if (!product) return std::nullopt;
+        return Arith{a.lhs, ArithOp::Mul, *y, m.make_const(*product)};
+    }},
+    // (a rop b) == 0  =>  a !rop b
+    {"not-cmp", kind_of<Cmp>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& c = std::get<Cmp>(inst);
+        if (c.rop != RelOp::Eq) return std::nullopt;
+        const VarId* t = m.is(c.right, 0) ? &c.left : m.is(c.left, 0) ? &c.right : nullptr;
+        auto* inner = t ? produced_as<Cmp>(m, *t) : nullptr;
+        if (!inner) return std::nullopt;
+        return Cmp{c.lhs, negate(inner->rop), inner->left, inner->right};
+    }},
+    // (a rop b) != 0  =>  a rop b
+    {"cmp-ne-zero", kind_of<Cmp>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& c = std::get<Cmp>(inst);
+        if (c.rop != RelOp::NotEq) return std::nullopt;
+        const VarId* t = m.is(c.right, 0) ? &c.left : m.is(c.left, 0) ? &c.right : nullptr;
+        auto* inner = t ? produced_as<Cmp>(m, *t) : nullptr;
+        if (!inner) return std::nullopt;
+        return Cmp{c.lhs, inner->rop, inner->left, inner->right};
+    }},
+    // x rop x  =>  0 or 1
+    {"cmp-self", kind_of<Cmp>(), [](const Inst& inst, Matcher& m) -> std::optional<Inst> {
+        auto& c = std::get<Cmp>(inst);
+        if (c.left != c.right) return std::nullopt;
+        return Copy{c.lhs, m.make_const(fold_cmp(c.rop, 0, 0))};
+    }},
+    // g ? x : x  =>  x
+    {"select-same", kind_of<Select>(), [](const Inst& inst, Matcher&) -> std::optional<Inst> {
+        auto& s = std::get<Select>(inst);
+        if (s.tt != s.ff) return std::nullopt;
+        return Copy{s.lhs, s.tt};
+    }},
+}};
+
+// A rewrite may enable another on the same instruction ((x + 1) - 1 becomes
+// x + 0, then x); stop after this many
+constexpr int MAX_REWRITES_PER_INST = 4;
+
+class PeepholePass : public FunctionPass {
+public:
+    const char* name() const override { return "peephole"; }
+    bool preserves_cfg() const override { return true; }
+
+    bool run(Function& fn, PassContext&) override {
+        auto constants = constant_values(fn);
+        std::set<int> needed;
+        Matcher m(constants, needed);
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            std::map<VarId, size_t> last_def;
+            m.reset(bb, last_def);
+            for (size_t i = 0; i < bb.insts.size(); ++i) {
+                Inst& inst = bb.insts[i];
+                for (int n = 0; n < MAX_REWRITES_PER_INST; ++n) {
+                    if (!apply_first(inst, m)) break;
+                    changed = true;
+                }
+                if (const VarId* def = inst_def(inst)) last_def[*def] = i;
+            }
+        }
+        for (int val : needed) ensure_const(fn, val);
+        return changed;
+    }
+
+    std::vector<std::pair<std::string, size_t>> counters() const override {
+        std::vector<std::pair<std::string, size_t>> out;
+        for (size_t r = 0; r < RULES.size(); ++r) out.emplace_back(RULES[r].name, m_fired[r].load());
+        return out;
+    }
+
+private:
+    bool apply_first(Inst& inst, Matcher& m) {
+        for (size_t r = 0; r < RULES.size(); ++r) {
+            if (RULES[r].kind != inst.index()) continue;
+            if (auto out = RULES[r].rewrite(inst, m)) {
+                inst = std::move(*out);
+                m_fired[r].fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Functions are processed concurrently; the counters are shared
+    std::array<std::atomic<size_t>, RULES.size()> m_fired{};
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> create_peephole_pass() { return std::make_unique<PeepholePass>(); }
+
+} // namespace LIR
@@ -0,0 +1,212 @@
+#include "lir_passes.hpp"
+#include "dataflow.hpp"
+#include "lir_utils.hpp"
+#include <functional>
+#include <queue>
+#include <set>
+
+// Sparse conditional constant propagation.
+//
+// LIR is not in SSA form (temporaries and named variables are reassigned), so
+// instead of one lattice value per SSA name the solver keeps a lattice value
+// per variable at the entry of each block. A variable is either a known
+// constant or varying; blocks are only evaluated once an edge into them is
+// known to execute, and a branch on a known guard only makes one of its
+// edges executable. Blocks that never execute are removed afterwards.
+
+namespace LIR {
+
+namespace {
+
+// nullopt = varying
+using LatticeVal = std::optional<int>;
+using State = std::vector<LatticeVal>;
+
+class SccpSolver {
+public:
+    SccpSolver(const Function& fn, const CFGInfo& cfg)
+        : m_fn(fn), m_cfg(cfg), m_vars(fn) {
+        for (size_t i = 0; i < cfg.rpo.size(); ++i) m_index[cfg.rpo[i]] = i;
+    }
+
+    void solve() {
+        size_t n = m_cfg.rpo.size();
+        m_in.assign(n, State(m_vars.size()));
+        m_out.assign(n, State(m_vars.size()));
+        m_visited.assign(n, false);
+        if (n == 0) return;
+
+        // Visit blocks in reverse postorder so loop bodies see their
+        // preheader's values before the back edge is followed
+        std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> worklist;
+        std::vector<bool> queued(n, false);
+        worklist.push(0);
+        queued[0] = true;
+        while (!worklist.empty()) {
+            size_t b = worklist.top();
+            worklist.pop();
+            queued[b] = false;
+
+            // Nothing is known on entry to the function: parameters and
+            // uninitialized locals are varying.
+            State in(m_vars.size());
+            bool first = true;
+            auto merge = [&](const State& other) {
+                if (first) { in = other; first = false; return; }
+                for (size_t v = 0; v < in.size(); ++v) {
+                    if (in[v] != other[v]) in[v] = std::nullopt;
+                }
+            };
+            if (b == 0) merge(State(m_vars.size()));
+            for (const auto& pred : m_cfg.preds.at(m_cfg.rpo[b])) {
+                auto it = m_index.find(pred);
+                if (it != m_index.end() && m_exec_edges.count({it->second, b})) merge(m_out[it->second]);
+            }
+            if (m_visited[b] && in == m_in[b]) continue;
+            m_visited[b] = true;
+            m_in[b] = in;
+
+            const BasicBlock& bb = m_fn.body.at(m_cfg.rpo[b]);
+            for (const auto& inst : bb.insts) step(inst, in);
+            bool out_changed = in != m_out[b];
+            m_out[b] = std::move(in);
+
+            for (const auto& succ : live_successors(bb.term, m_out[b])) {
+                size_t s = m_index.at(succ);
+                bool new_edge = m_exec_edges.insert({b, s}).second;
+                if ((new_edge || out_changed) && !queued[s]) {
+                    queued[s] = true;
+                    worklist.push(s);
+                }
+            }
+        }
+    }
+
+    bool executed(const BbId& label) const {
+        auto it = m_index.find(label);
+        return it != m_index.end() && m_visited[it->second];
+    }
+    const State& in_state(const BbId& label) const { return m_in[m_index.at(label)]; }
+
+    LatticeVal value_of(const State& state, const VarId& v) const {
+        uint32_t id = m_vars.id(v);
+        return id == VarIndex::NONE ? std::nullopt : state[id];
+    }
+
+    // Value `inst` assigns to its def, given the values before it
+    LatticeVal evaluate(const Inst& inst, const State& state) const {
+        if (auto* c = std::get_if<Const>(&inst)) return c->val;
+        if (auto* copy = std::get_if<Copy>(&inst)) return value_of(state, copy->op);
+        if (auto* arith = std::get_if<Arith>(&inst)) {
+            auto l = value_of(state, arith->left), r = value_of(state, arith->right);
+            if (!l || !r) return std::nullopt;
+            return fold_arith(arith->aop, *l, *r);
+        }
+        if (auto* cmp = std::get_if<Cmp>(&inst)) {
+            auto l = value_of(state, cmp->left), r = value_of(state, cmp->right);
+            if (!l || !r) return std::nullopt;
+            return fold_cmp(cmp->rop, *l, *r);
+        }
+        if (auto* sel = std::get_if<Select>(&inst)) {
+            if (auto g = value_of(state, sel->guard)) return value_of(state, *g != 0 ? sel->tt : sel->ff);
+            auto a = value_of(state, sel->tt), b = value_of(state, sel->ff);
+            return a == b ? a : std::nullopt;
+        }
+        return std::nullopt; // loads, calls, addresses and allocations
+    }
+
+    void step(const Inst& inst, State& state) const { assign(inst, evaluate(inst, state), state); }
+
+    void assign(const Inst& inst, LatticeVal val, State& state) const {
+        if (const VarId* def = inst_def(inst)) {
+            uint32_t id = m_vars.id(*def);
+            if (id != VarIndex::NONE) state[id] = val;
+        }
+    }
+
+    // The only successor of a branch whose condition is known
+    std::optional<BbId> known_target(const Terminal& term, const State& state) const {
+        if (auto* branch = std::get_if<Branch>(&term)) {
+            if (auto g = value_of(state, branch->guard)) return *g != 0 ? branch->tt : branch->ff;
+        } else if (auto* bc = std::get_if<BranchCmp>(&term)) {
+            auto l = value_of(state, bc->left), r = value_of(state, bc->right);
+            if (l && r) return fold_cmp(bc->rop, *l, *r) ? bc->tt : bc->ff;
+        }
+        return std::nullopt;
+    }
+
+    // Successors that can execute given the values at the end of the block
+    std::vector<BbId> live_successors(const Terminal& term, const State& state) const {
+        if (auto taken = known_target(term, state)) return {*taken};
+        std::vector<BbId> succs;
+        for (const auto& succ : successors(term)) {
+            if (m_index.count(succ)) succs.push_back(succ);
+        }
+        return succs;
+    }
+
+private:
+    const Function& m_fn;
+    const CFGInfo& m_cfg;
+    VarIndex m_vars;
+    std::map<BbId, size_t> m_index; // rpo position
+    std::vector<State> m_in, m_out;
+    std::vector<bool> m_visited;
+    std::set<std::pair<size_t, size_t>> m_exec_edges;
+};
+
+class SccpPass : public FunctionPass {
+public:
+    const char* name() const override { return "sccp"; }
+    bool run(Function& fn, PassContext& ctx) override {
+        SccpSolver solver(fn, ctx.am.get<CFGInfo>(fn));
+        solver.solve();
+
+        // Rewrite in place; the constants are created at the end because
+        // ensure_const() inserts into the entry block.
+        std::set<int> needed;
+        bool changed = false;
+        for (auto& [label, bb] : fn.body) {
+            if (!solver.executed(label)) continue;
+            State state = solver.in_state(label);
+            auto rewrite = [&](VarId& use) {
+                auto val = solver.value_of(state, use);
+                if (!val) return;
+                VarId name = const_name(*val);
+                if (use == name) return;
+                use = std::move(name);
+                needed.insert(*val);
+                changed = true;
+            };
+            for (auto& inst : bb.insts) {
+                LatticeVal val = solver.evaluate(inst, state);
+                for_each_use(inst, rewrite);
+                // A computation with a known result becomes a copy of it
+                if (val && (std::holds_alternative<Arith>(inst) || std::holds_alternative<Cmp>(inst) ||
+                            std::holds_alternative<Select>(inst))) {
+                    VarId lhs = *inst_def(inst);
+                    inst = Copy{lhs, const_name(*val)};
+                    needed.insert(*val);
+                    changed = true;
+                }
+                solver.assign(inst, val, state);
+            }
+            if (auto taken = solver.known_target(bb.term, state)) {
+                bb.term = Jump{*taken};
+                changed = true;
+                continue;
+            }
+            for_each_term_use(bb.term, rewrite);
+        }
+        for (int val : needed) ensure_const(fn, val);
+
+        // Blocks that never execute are unreachable once their branches are folded
+        return remove_unreachable_blocks(fn) || changed;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> create_sccp_pass() { return std::make_unique<SccpPass>(); }
+
+} // namespace LIR
@@ -0,0 +1,166 @@
+#include "spill.hpp"
+#include "ast.hpp"
+#include "lir_binary.hpp"
+#include "lir_passes.hpp"
+#include "lir_utils.hpp"
+#include "lir_verifier.hpp"
+#include "pass_manager.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+// Rough heap footprint of `fn`: container elements and nodes plus the
+// strings too long for the small-string buffer. A budget only needs the
+// right order of magnitude.
+size_t estimated_bytes(const LIR::Function& fn) {
+    constexpr size_t MAP_NODE = 32; // links and color of a std::map node
+    auto heap = [](const std::string& s) -> size_t { return s.capacity() > 15 ? s.capacity() + 1 : 0; };
+
+    size_t bytes = sizeof(LIR::Function) + heap(fn.name) + fn.params.capacity() * sizeof(fn.params[0]);
+    for (const auto& [name, type] : fn.locals) {
+        bytes += MAP_NODE + sizeof(std::pair<const LIR::VarId, LIR::TypePtr>) + heap(name);
+    }
+    for (const auto& [label, bb] : fn.body) {
+        bytes += MAP_NODE + sizeof(std::pair<const LIR::BbId, LIR::BasicBlock>) + heap(label) + heap(bb.label);
+        bytes += bb.insts.capacity() * sizeof(LIR::Inst);
+        for (const auto& inst : bb.insts) {
+            LIR::for_each_operand(inst, [&](const LIR::VarId& v) { bytes += heap(v); });
+        }
+        LIR::for_each_term_use(bb.term, [&](const LIR::VarId& v) { bytes += heap(v); });
+    }
+    return bytes;
+}
+
+// An unlinked temporary file of lirb chunks, each holding the functions
+// spilled at once
+class SpillFile {
+public:
+    SpillFile() {
+        const char* dir = std::getenv("TMPDIR");
+        std::string path = std::string(dir && *dir ? dir : "/tmp") + "/lower-spill-XXXXXX";
+        m_fd = ::mkstemp(&path[0]);
+        if (m_fd < 0) throw std::runtime_error("cannot create spill file " + path + ": " + std::strerror(errno));
+        // Gone with the last descriptor, however the process ends
+        ::unlink(path.c_str());
+    }
+    ~SpillFile() { ::close(m_fd); }
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    void append(const LIR::Program& chunk) {
+        std::string bytes = LIR::encode_lirb(chunk);
+        uint64_t offset = m_size;
+        for (size_t done = 0; done < bytes.size();) {
+            ssize_t n = ::pwrite(m_fd, bytes.data() + done, bytes.size() - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("cannot write spill file: ") + std::strerror(errno));
+            }
+            done += static_cast<size_t>(n);
+        }
+        m_chunks.push_back({offset, bytes.size()});
+        m_size += bytes.size();
+    }
+
+    size_t chunk_count() const { return m_chunks.size(); }
+    uint64_t size() const { return m_size; }
+
+    std::string read(size_t i) const {
+        auto [offset, size] = m_chunks[i];
+        std::string bytes(size, '\0');
+        for (size_t done = 0; done < size;) {
+            ssize_t n = ::pread(m_fd, &bytes[done], size - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw std::runtime_error("cannot read spill file");
+            done += static_cast<size_t>(n);
+        }
+        return bytes;
+    }
+
+private:
+    int m_fd;
+    std::vector<std::pair<uint64_t, size_t>> m_chunks; // offset, size
+    uint64_t m_size = 0;
+};
+
+} // namespace
+
+void lower_within_budget(nlohmann::json& j, const BudgetOptions& options, LIR::LirEmitter& out) {
+    // Signatures of everything: enough to lower any single function body
+    AST::Program sigs;
+    for (const auto& structJson : j.at("structs")) sigs.structs.push_back(buildStructDef(structJson));
+    for (const auto& externJson : j.at("externs")) sigs.externs.push_back(buildExtern(externJson));
+    auto& funcs = j.at("functions");
+    for (const auto& funcJson : funcs) sigs.functions.push_back(buildFunctionSignature(funcJson));
+
+    Lowerer lowerer(options.lower);
+    LIR::Program& module = lowerer.begin_module(&sigs);
+
+    // In output order, so the chunks and the functions kept at the end
+    // follow each other
+    std::vector<size_t> order(sigs.functions.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sigs.functions[a]->name < sigs.functions[b]->name;
+    });
+
+    // The module part of build_pipeline() is dead-externs at -O2
+    LIR::PassManager pm = LIR::build_function_pipeline(options.opt_level, 1, options.fuse_branch_cmp);
+    bool drop_externs = options.opt_level >= 2;
+    std::set<LIR::VarId> referenced;
+
+    LIR::Program kept;
+    size_t kept_bytes = 0;
+    size_t spilled = 0;
+    std::unique_ptr<SpillFile> spill;
+    for (size_t idx : order) {
+        AST::FunctionDef* def = sigs.functions[idx].get();
+        def->body = buildFunctionBody(funcs[idx]);
+        funcs[idx] = nullptr;
+
+        LIR::Function lowered = lowerer.lower_function(def);
+        def->body.reset();
+        auto it = module.functions.emplace(lowered.name, std::move(lowered)).first;
+        if (options.verify) LIR::verify(module);
+        pm.run(module);
+        if (options.verify) LIR::verify(module);
+        LIR::Function fn = std::move(it->second);
+        module.functions.clear();
+
+        if (drop_externs) LIR::collect_references(fn, referenced);
+        kept_bytes += estimated_bytes(fn);
+        LIR::FuncId name = fn.name;
+        kept.functions.emplace(std::move(name), std::move(fn));
+        if (kept_bytes > options.mem_limit) {
+            if (!spill) spill = std::make_unique<SpillFile>();
+            spill->append(kept);
+            spilled += kept.functions.size();
+            kept.functions.clear();
+            kept_bytes = 0;
+        }
+    }
+
+    if (drop_externs) LIR::drop_unreferenced_externs(module, referenced);
+    out.emit_header(module);
+    for (size_t i = 0; spill && i < spill->chunk_count(); ++i) {
+        std::string bytes = spill->read(i);
+        LIR::LirbFile chunk(bytes.data(), bytes.size());
+        for (size_t k = 0; k < chunk.function_count(); ++k) out.emit_function(chunk.read_function(k));
+    }
+    for (const auto& [name, fn] : kept.functions) out.emit_function(fn);
+
+    if (options.time_passes) {
+        pm.print_report(std::cerr);
+        std::cerr << "Spilled " << spilled << " of " << order.size() << " function(s) in "
+                  << (spill ? spill->chunk_count() : 0) << " chunk(s), " << (spill ? spill->size() : 0)
+                  << " bytes\n";
+    }
+}
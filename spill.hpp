@@ -0,0 +1,33 @@
+#pragma once
+
+#include "json.hpp"
+#include "lir_emitter.hpp"
+#include "lowerer.hpp"
+
+// Memory-budgeted lowering (--mem-limit): functions are lowered and
+// optimized one at a time in output order, as in --stream, but kept until
+// the end so the whole program can be printed as usual. Once the estimated
+// size of the kept functions passes the limit, they are appended to an
+// unlinked temporary file as one lirb chunk (lir_binary.hpp) and freed.
+// Output reads the chunks back one at a time, so the output is identical to
+// a normal run while the LIR held at once stays near the limit.
+//
+// The AST is built one function at a time and each function's JSON is freed
+// once it is lowered; the JSON document itself is parsed up front. The one
+// module pass, dead-externs at -O2, runs from the names each function refers
+// to, collected before it is spilled.
+
+struct BudgetOptions {
+    LowerOptions lower;
+    int opt_level = 0;
+    bool fuse_branch_cmp = false;
+    bool verify = false;
+    bool time_passes = false;
+    // Bytes of LIR kept in memory before spilling
+    size_t mem_limit = 0;
+};
+
+// Lowers the program in `j` and writes its text to `out`. Function entries
+// of `j` are released as they are consumed. Throws std::runtime_error (or a
+// JSON exception for malformed input).
+void lower_within_budget(nlohmann::json& j, const BudgetOptions& options, LIR::LirEmitter& out);
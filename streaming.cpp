@@ -0,0 +1,48 @@
+#include "streaming.hpp"
+#include "ast.hpp"
+#include "lir_verifier.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+void lower_streaming(nlohmann::json& j, const StreamOptions& options, LIR::LirEmitter& out) {
+    if (options.opt_level > 1) {
+        throw std::runtime_error("streaming supports -O0 and -O1 only (-O2 rewrites the extern list)");
+    }
+
+    // Signatures of everything: enough to lower any single function body
+    AST::Program sigs;
+    for (const auto& structJson : j.at("structs")) sigs.structs.push_back(buildStructDef(structJson));
+    for (const auto& externJson : j.at("externs")) sigs.externs.push_back(buildExtern(externJson));
+    auto& funcs = j.at("functions");
+    for (const auto& funcJson : funcs) sigs.functions.push_back(buildFunctionSignature(funcJson));
+
+    Lowerer lowerer(options.lower);
+    LIR::Program& module = lowerer.begin_module(&sigs);
+    out.emit_header(module);
+
+    // Output is in name order; lowering a function only needs the signatures
+    std::vector<size_t> order(sigs.functions.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sigs.functions[a]->name < sigs.functions[b]->name;
+    });
+
+    LIR::PassManager pm = LIR::build_pipeline(options.opt_level, 1, options.fuse_branch_cmp);
+    for (size_t idx : order) {
+        AST::FunctionDef* def = sigs.functions[idx].get();
+        def->body = buildFunctionBody(funcs[idx]);
+        funcs[idx] = nullptr;
+
+        LIR::Function fn = lowerer.lower_function(def);
+        def->body.reset();
+        auto it = module.functions.emplace(fn.name, std::move(fn)).first;
+        if (options.verify) LIR::verify(module);
+        pm.run(module);
+        if (options.verify) LIR::verify(module);
+
+        out.emit_function(it->second);
+        module.functions.clear();
+    }
+    if (options.time_passes) pm.print_report(std::cerr);
+}
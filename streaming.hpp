@@ -0,0 +1,25 @@
+#pragma once
+
+#include "json.hpp"
+#include "lir_emitter.hpp"
+#include "lowerer.hpp"
+#include "pass_manager.hpp"
+
+// Streaming lowering (--stream): instead of building the whole AST and LIR
+// program before printing, lower the signatures first and then, one function
+// at a time in output order, build its AST, lower, optimize and print it and
+// free it again. Peak memory is then set by the largest function instead of
+// the whole program (plus the JSON document, which is parsed up front).
+
+struct StreamOptions {
+    LowerOptions lower;
+    int opt_level = 0; // module passes cannot run, so at most 1
+    bool fuse_branch_cmp = false;
+    bool verify = false;
+    bool time_passes = false;
+};
+
+// Lowers the program in `j` and writes its text to `out`. Function entries
+// of `j` are released as they are consumed. Throws std::runtime_error (or a
+// JSON exception for malformed input).
+void lower_streaming(nlohmann::json& j, const StreamOptions& options, LIR::LirEmitter& out);
@@ -0,0 +1,148 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace {
+
+// Which pool, if any, the current thread works for
+struct WorkerId {
+    const ThreadPool* pool = nullptr;
+    size_t index = 0;
+};
+thread_local WorkerId t_worker;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t w = 0; w < std::max<size_t>(threads, 1); ++w) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t w = 1; w < m_queues.size(); ++w) {
+        m_workers.emplace_back([this, w] { worker_loop(w); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_workers) {
+        t.join();
+    }
+}
+
+size_t ThreadPool::resolve_threads(size_t requested) {
+    if (requested > 0) return requested;
+    size_t hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+size_t ThreadPool::current_worker() const {
+    return t_worker.pool == this ? t_worker.index : 0;
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, size_t)>& body) {
+    if (n == 0) return;
+    size_t self = current_worker();
+    if (size() == 1) {
+        for (size_t i = 0; i < n; ++i) body(i, self);
+        return;
+    }
+
+    // The caller and its helpers take items from one counter until it runs out
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto run_items = [&](size_t worker) {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n; ) {
+            try {
+                body(i, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next.store(n, std::memory_order_relaxed); // stop handing out work
+            }
+        }
+    };
+
+    TaskGroup group;
+    size_t helpers = std::min(n, size()) - 1;
+    for (size_t h = 0; h < helpers; ++h) {
+        spawn(self, group, run_items);
+    }
+    run_items(self);
+    wait(self, group);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::spawn(size_t worker, TaskGroup& group, std::function<void(size_t)> run) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    // Counted before it is visible, so a thief's decrement never comes first
+    m_queued.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_queues[worker]->mutex);
+        m_queues[worker]->tasks.push_back(Task{std::move(run), &group});
+    }
+    // Taking the lock orders this against a sleeper's check of m_queued
+    { std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::run_one(size_t worker) {
+    Task task;
+    bool found = false;
+    {
+        // Own tasks newest first: they are the ones this worker waits for
+        Queue& own = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (size_t k = 1; !found && k < m_queues.size(); ++k) {
+        // Others' tasks oldest first
+        Queue& victim = *m_queues[(worker + k) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+
+    task.run(worker);
+    // The group may be gone as soon as its count drops to zero
+    if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        { std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+        m_wake.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::wait(size_t worker, TaskGroup& group) {
+    while (group.pending.load(std::memory_order_acquire) > 0) {
+        if (run_one(worker)) continue;
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_wake.wait(lock, [&] {
+            return group.pending.load(std::memory_order_acquire) == 0 ||
+                   m_queued.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+    t_worker = WorkerId{this, worker};
+    while (true) {
+        if (run_one(worker)) continue;
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_stop) return;
+    }
+}
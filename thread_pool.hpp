@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- Scratch Arena ---
+
+// Bump allocator for short-lived data a worker needs while processing one
+// item (e.g. a pass's temporary maps). reset() makes all of it reusable
+// without returning memory to the system.
+class ScratchArena {
+public:
+    explicit ScratchArena(size_t initial_bytes = 64 * 1024)
+        : m_buffer(initial_bytes), m_resource(m_buffer.data(), m_buffer.size()) {}
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &m_resource; }
+    void reset() { m_resource.release(); }
+
+private:
+    std::vector<std::byte> m_buffer;
+    std::pmr::monotonic_buffer_resource m_resource;
+};
+
+// --- Thread Pool ---
+
+// A fixed set of worker threads for data-parallel loops, scheduled by work
+// stealing. The calling thread takes part as worker 0, so a pool of size 1
+// runs everything inline.
+//
+// Each worker owns a deque of tasks: it pushes and pops its own at the back
+// and, when that is empty, steals from the front of the others'. A
+// parallel_for spawns one task per other worker that takes items from the
+// loop's shared counter, so items are still handed out in index order, and
+// waits by running tasks itself. Loops may therefore nest: a task that starts
+// its own parallel_for (a file whose functions are processed in parallel, say)
+// puts helpers on its deque that idle workers steal.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return m_queues.size(); }
+
+    // Runs body(i, worker) for every i in [0, n) and waits for all of them.
+    // Items are handed out in index order; `worker` is in [0, size()). While
+    // an item waits for a nested parallel_for its worker runs other tasks,
+    // possibly items of this same loop; items that do not nest never share a
+    // worker. The first exception thrown by any item is rethrown here, and no
+    // new items start after it.
+    void parallel_for(size_t n, const std::function<void(size_t, size_t)>& body);
+
+    // Number of threads for a --threads=N request (0 means all cores).
+    static size_t resolve_threads(size_t requested);
+
+private:
+    // Tasks still to finish before a wait() returns
+    struct TaskGroup {
+        std::atomic<size_t> pending{0};
+    };
+
+    struct Task {
+        std::function<void(size_t)> run; // gets the worker index
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // The worker the calling thread is in this pool (0 for other threads)
+    size_t current_worker() const;
+    void spawn(size_t worker, TaskGroup& group, std::function<void(size_t)> run);
+    // Runs tasks on `worker` until every task of `group` is done
+    void wait(size_t worker, TaskGroup& group);
+    // Pops a task of `worker` or steals one; false if every deque was empty
+    bool run_one(size_t worker);
+    void worker_loop(size_t worker);
+
+    std::vector<std::unique_ptr<Queue>> m_queues; // one per worker
+    std::vector<std::thread> m_workers;           // workers 1..size()-1
+    std::atomic<size_t> m_queued{0};              // tasks in all deques
+
+    // Idle workers and waiters sleep here until there is a task to take or
+    // a group finishes
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
@@ -0,0 +1,280 @@
+#include "watch.hpp"
+#include "ast.hpp"
+#include "lir_verifier.hpp"
+#include "pass_manager.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// One function's JSON and its lowered, optimized LIR
+struct CachedFunction {
+    nlohmann::json source;
+    LIR::Function lir;
+};
+
+// What is kept of an input between changes
+struct InputState {
+    nlohmann::json signature;
+    std::map<LIR::FuncId, CachedFunction> functions;
+};
+
+// Everything besides its own body that lowering a function depends on
+nlohmann::json signature_of(const nlohmann::json& j) {
+    nlohmann::json headers = nlohmann::json::array();
+    for (const auto& fn : j.at("functions")) {
+        nlohmann::json header = nlohmann::json::object();
+        for (auto it = fn.begin(); it != fn.end(); ++it) {
+            if (it.key() != "stmts") header[it.key()] = it.value();
+        }
+        headers.push_back(std::move(header));
+    }
+    return {{"structs", j.at("structs")}, {"externs", j.at("externs")}, {"functions", std::move(headers)}};
+}
+
+// A worker's lowerer and function passes; the lowerer's module holds one
+// function at a time while the passes run on it, as in --stream
+struct Worker {
+    explicit Worker(const BatchOptions& options)
+        : lowerer(options.lower), pm(LIR::build_function_pipeline(options.opt_level, 1, options.fuse_branch_cmp)) {}
+
+    Lowerer lowerer;
+    LIR::PassManager pm;
+    LIR::Program* module = nullptr;
+};
+
+class IncrementalLowerer {
+public:
+    IncrementalLowerer(const std::string& out_dir, const BatchOptions& options)
+        : m_out_dir(out_dir), m_options(options), m_pool(options.threads),
+          m_workers(m_pool.size()), m_module_pm(LIR::build_module_pipeline(options.opt_level)) {
+        reset_workers();
+    }
+
+    // Re-lowers the input at `path` and rewrites its output
+    void update(const fs::path& path) {
+        auto start = std::chrono::steady_clock::now();
+        nlohmann::json j;
+        {
+            std::ifstream input(path);
+            if (!input) throw std::runtime_error("cannot open " + path.string());
+            j = nlohmann::json::parse(input);
+        }
+
+        InputState& state = m_inputs[path];
+        nlohmann::json signature = signature_of(j);
+        if (signature != state.signature) {
+            state.functions.clear();
+            state.signature = std::move(signature);
+        }
+
+        AST::Program sigs;
+        for (const auto& structJson : j.at("structs")) sigs.structs.push_back(buildStructDef(structJson));
+        for (const auto& externJson : j.at("externs")) sigs.externs.push_back(buildExtern(externJson));
+        auto& funcs = j.at("functions");
+        for (const auto& funcJson : funcs) sigs.functions.push_back(buildFunctionSignature(funcJson));
+
+        std::vector<size_t> stale;
+        for (size_t i = 0; i < funcs.size(); ++i) {
+            auto it = state.functions.find(sigs.functions[i]->name);
+            if (it == state.functions.end() || it->second.source != funcs[i]) stale.push_back(i);
+        }
+
+        std::vector<LIR::Function> lowered(stale.size());
+        std::vector<char> started(m_workers.size()); // not vector<bool>: written concurrently
+        try {
+            m_pool.parallel_for(stale.size(), [&](size_t k, size_t w) {
+                Worker& worker = *m_workers[w];
+                if (!started[w]) {
+                    worker.module = &worker.lowerer.begin_module(&sigs);
+                    started[w] = true;
+                }
+                AST::FunctionDef* def = sigs.functions[stale[k]].get();
+                def->body = buildFunctionBody(funcs[stale[k]]);
+                LIR::Function fn = worker.lowerer.lower_function(def);
+                def->body.reset();
+
+                auto it = worker.module->functions.emplace(fn.name, std::move(fn)).first;
+                if (m_options.verify) LIR::verify(*worker.module);
+                worker.pm.run(*worker.module);
+                lowered[k] = std::move(it->second);
+                worker.module->functions.clear();
+            });
+        } catch (...) {
+            // A lowering cut short may leave state behind
+            reset_workers();
+            throw;
+        }
+
+        // Functions no longer in the input are dropped
+        std::map<LIR::FuncId, CachedFunction> functions;
+        for (size_t i = 0, k = 0; i < funcs.size(); ++i) {
+            const LIR::FuncId& name = sigs.functions[i]->name;
+            if (k < stale.size() && stale[k] == i) {
+                functions[name] = CachedFunction{std::move(funcs[i]), std::move(lowered[k++])};
+            } else {
+                functions[name] = std::move(state.functions.at(name));
+            }
+        }
+        state.functions = std::move(functions);
+
+        Lowerer module_lowerer(m_options.lower);
+        LIR::Program prog = module_lowerer.begin_module(&sigs);
+        for (const auto& [name, cached] : state.functions) prog.functions.emplace(name, cached.lir);
+        m_module_pm.run(prog);
+        if (m_options.verify) LIR::verify(prog);
+        write_output(path, prog);
+
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Updated " << output_path(path).string() << " (" << stale.size() << " of " << funcs.size()
+                  << " function(s) lowered, " << ms << " ms)\n";
+        if (m_options.time_passes) {
+            std::vector<const LIR::PassManager*> pms;
+            for (const auto& worker : m_workers) pms.push_back(&worker->pm);
+            LIR::PassManager::print_report(std::cerr, pms);
+            m_module_pm.print_report(std::cerr);
+        }
+    }
+
+    void forget(const fs::path& path) { m_inputs.erase(path); }
+
+    // Drops every input not in `present`
+    void retain(const std::set<fs::path>& present) {
+        for (auto it = m_inputs.begin(); it != m_inputs.end();) {
+            it = present.count(it->first) ? std::next(it) : m_inputs.erase(it);
+        }
+    }
+
+private:
+    fs::path output_path(const fs::path& input) const {
+        fs::path out = fs::path(m_out_dir) / input.stem();
+        switch (m_options.format) {
+            case OutputFormat::Text: out += ".lir"; break;
+            case OutputFormat::Lirb: out += ".lirb"; break;
+            case OutputFormat::Json: out += ".json"; break;
+        }
+        return out;
+    }
+
+    // Written next to the output and renamed over it, so readers never see
+    // half of it
+    void write_output(const fs::path& input, const LIR::Program& prog) {
+        fs::path out = output_path(input);
+        fs::path tmp = out;
+        tmp += ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("cannot create " + tmp.string() + ": " + std::strerror(errno));
+        try {
+            m_emitter.retarget(fd);
+            emit_program(prog, m_options.format, m_emitter, m_pool.size() > 1 ? &m_pool : nullptr);
+            m_emitter.flush();
+        } catch (...) {
+            m_emitter.discard();
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw;
+        }
+        ::close(fd);
+        if (::rename(tmp.c_str(), out.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("cannot replace " + out.string() + ": " + std::strerror(errno));
+        }
+    }
+
+    void reset_workers() {
+        for (auto& worker : m_workers) worker = std::make_unique<Worker>(m_options);
+    }
+
+    std::string m_out_dir;
+    BatchOptions m_options;
+    ThreadPool m_pool;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    LIR::PassManager m_module_pm;
+    LIR::LirEmitter m_emitter{-1};
+    std::map<fs::path, InputState> m_inputs;
+};
+
+bool is_watched(const fs::path& path) { return path.extension() == ".astj"; }
+
+std::set<fs::path> scan_inputs(const std::string& dir) {
+    std::set<fs::path> inputs;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.is_regular_file() && is_watched(entry.path())) inputs.insert(entry.path());
+    }
+    return inputs;
+}
+
+} // namespace
+
+void run_watch(const std::string& dir, const std::string& out_dir, const BatchOptions& options) {
+    fs::create_directories(out_dir);
+    int fd = ::inotify_init1(IN_CLOEXEC);
+    if (fd < 0) throw std::runtime_error(std::string("inotify: ") + std::strerror(errno));
+    // Writers either rewrite an input in place or rename a finished file over it
+    if (::inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot watch " + dir + ": " + std::strerror(errno));
+    }
+
+    IncrementalLowerer lowerer(out_dir, options);
+    auto update = [&](const fs::path& path) {
+        try {
+            lowerer.update(path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << path.string() << ": " << e.what() << "\n";
+            lowerer.forget(path);
+        }
+    };
+
+    // Inputs changed from here on are queued by inotify already
+    for (const auto& path : scan_inputs(dir)) update(path);
+    std::cerr << "Watching " << dir << "\n";
+
+    alignas(struct inotify_event) char buf[64 * 1024];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            throw std::runtime_error(std::string("inotify: ") + std::strerror(errno));
+        }
+        // Several events for one input in a read are handled once
+        std::set<fs::path> changed;
+        bool overflowed = false;
+        for (char* p = buf; p < buf + n;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) overflowed = true;
+            if (event->len == 0) continue;
+            fs::path path = fs::path(dir) / event->name;
+            if (!is_watched(path)) continue;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changed.erase(path);
+                lowerer.forget(path);
+            } else {
+                changed.insert(path);
+            }
+        }
+        // Events were dropped, so any input may have changed or gone
+        if (overflowed) {
+            std::cerr << "inotify queue overflowed, rescanning " << dir << "\n";
+            changed = scan_inputs(dir);
+            lowerer.retain(changed);
+        }
+        for (const auto& path : changed) update(path);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "batch.hpp"
+#include <string>
+
+// Watch mode (--watch): lower every .astj file of a directory, then wait for
+// inotify to report inputs written or moved into it and re-lower just those.
+//
+// Between changes each input keeps its signatures (structs, externs and
+// function headers) and, per function, its JSON and its lowered and
+// optimized LIR. A change re-lowers only the functions whose JSON differs;
+// if the signatures changed, every function of the input is lowered again.
+// Function passes only look at the function they run on, so a reused
+// function is exactly what a full run would produce, and the module passes
+// run on the reassembled program. Outputs replace the old ones atomically.
+
+// Lowers the .astj inputs of `dir` into `out_dir` (created if missing) as
+// <stem>.lir, .lirb or .json, and keeps them up to date until the process is
+// interrupted. Errors of an input are reported on stderr and leave its old
+// output in place; failing to watch `dir` throws std::runtime_error.
+void run_watch(const std::string& dir, const std::string& out_dir, const BatchOptions& options);